@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <io.h>
+#include "camera.h"
+#include "image.h"
+#include "image_compare.h"
+#include "image_export.h"
+#include "downscale.h"
+#include "test_pattern.h"
+#include "cycles.h"
+#include "bench.h"
+
+/* Frame pipeline benchmarks
+ *
+ * Times the per-frame hot paths with the cycle counter, on the target or in
+ * the host build. Each benchmark runs once untimed, then BENCH_ITERATIONS
+ * timed iterations. Results are printed one per line as CSV, prefixed with
+ * "bench," so that they can be extracted from the console output:
+ *
+ *   bench,name,unit,units,iterations,cycles_min,cycles_mean,cycles_per_unit,ns_per_unit,per_s
+ *
+ * units is the work of one iteration: pixels, or i2c transactions for the
+ * register sequences. per_s is iterations per second, i.e. frames/s for the
+ * full frame benchmarks. Fractional values have three decimals.
+ */
+
+#define BENCH_FILL          0xdead
+#define BENCH_PRINT_WIDTH   32      /* print_image_xy() area of the main loop */
+#define BENCH_PRINT_HEIGHT  2
+
+typedef struct bench {
+    const char *name;
+    const char *unit;
+    uint32_t units;             /* per iteration, 0: mean i2c transactions per iteration */
+    void (*run)(void);
+} bench;
+
+static uint16_t *_frame;
+static i2c_dev *_i2c;
+static uint8_t _row[3 * IMAGE_WIDTH];
+static char _text[IMAGE_XY_TEXT_SIZE(BENCH_PRINT_WIDTH, BENCH_PRINT_HEIGHT)];
+static volatile uint32_t _sink;
+static unsigned _config_toggle;
+
+static void run_clear_image_buffer(void)
+{
+    clear_image_buffer(_frame, BENCH_FILL);
+}
+
+static void run_image_fill_uncached(void)
+{
+    image_fill(_frame, IMAGE_SIZE, BENCH_FILL, IMAGE_FILL_UNCACHED);
+}
+
+static void run_image_fill_cached(void)
+{
+    image_fill(_frame, IMAGE_SIZE, BENCH_FILL, IMAGE_FILL_CACHED);
+}
+
+/* The frame holds BENCH_FILL only: the whole frame is scanned */
+static void run_compare_image_to_default(void)
+{
+    compare_image_to_default(_frame, BENCH_FILL);
+}
+
+static void run_image_compare(void)
+{
+    _sink = image_compare(_frame, IMAGE_SIZE, BENCH_FILL, NULL);
+}
+
+static void run_image_sample_diff(void)
+{
+    _sink = image_sample_diff(_frame, IMAGE_SIZE, BENCH_FILL);
+}
+
+static void run_rgb888(void)
+{
+    for (unsigned lin = 0; lin < IMAGE_HEIGHT; lin++) {
+        export_row_rgb888(_frame, lin, _row, NULL);
+    }
+    _sink = _row[0];
+}
+
+/* Reference: the former conversion, 16-bit loads, shifts without bit
+ * replication */
+static void run_rgb888_shift(void)
+{
+    for (unsigned lin = 0; lin < IMAGE_HEIGHT; lin++) {
+        uint8_t *dst = _row;
+        for (unsigned col = 0; col < IMAGE_WIDTH; col++) {
+            uint16_t pixel = IORD_16DIRECT(_frame, 2*(IMAGE_WIDTH * lin + col));
+            *dst++ = (uint8_t)((pixel >> 11) & 0b11111)<<3;
+            *dst++ = (uint8_t)((pixel >> 5) & 0b111111)<<2;
+            *dst++ = (uint8_t)(pixel & 0b11111)<<3;
+        }
+    }
+    _sink = _row[0];
+}
+
+/* Conversion with a checksum fused in, kinds CHECKSUM_* */
+static void rgb888_checksum(unsigned kinds)
+{
+    checksum_state st;
+    frame_checksum sum;
+
+    checksum_init(&st, kinds);
+    for (unsigned lin = 0; lin < IMAGE_HEIGHT; lin++) {
+        export_row_rgb888(_frame, lin, _row, &st);
+    }
+    checksum_final(&st, &sum);
+    _sink = sum.crc32 ^ sum.murmur3;
+}
+
+static void run_rgb888_crc32(void)
+{
+    rgb888_checksum(CHECKSUM_CRC32);
+}
+
+static void run_rgb888_murmur3(void)
+{
+    rgb888_checksum(CHECKSUM_MURMUR3);
+}
+
+/* In place: the frame content does not change the timing */
+static void run_downscale_2x(void)
+{
+    _sink = downscale(_frame, 1, _frame);
+}
+
+static void run_downscale_4x(void)
+{
+    _sink = downscale(_frame, 2, _frame);
+}
+
+static void run_get_pixel_xy(void)
+{
+    uint32_t sum = 0;
+
+    for (unsigned y = 0; y < IMAGE_HEIGHT; y++) {
+        for (unsigned x = 0; x < IMAGE_WIDTH; x++) {
+            sum += get_pixel_xy(_frame, x, y);
+        }
+    }
+    _sink = sum;
+}
+
+/* The formatting of print_image_xy(), into memory: printing would mix the
+ * pixel dump with the CSV results and time the console. */
+static void run_format_image_xy(void)
+{
+    _sink = format_image_xy(_text, sizeof(_text), _frame, 0, 0, BENCH_PRINT_WIDTH, BENCH_PRINT_HEIGHT);
+}
+
+/* Generates the default test pattern on the first (untimed) run: the frame
+ * matches, the whole frame is compared. Must be the last frame benchmark.
+ */
+static void run_test_pattern_verify(void)
+{
+    static bool generated;
+    test_pattern_result res;
+
+    if (!generated) {
+        test_pattern_generate(&camera_config_default, 0, _frame);
+        generated = true;
+    }
+    _sink = test_pattern_verify(_frame, &camera_config_default, &res);
+}
+
+static void run_camera_setup(void)
+{
+    camera_setup(_i2c, _frame, NULL, NULL);
+}
+
+/* Alternates between two configurations differing in a few registers */
+static void run_camera_apply_config(void)
+{
+    camera_config cfg = camera_config_default;
+
+    if (_config_toggle++ % 2) {
+        cfg.shutter_width = 1000;
+        cfg.vertical_blank = 25;
+        cfg.test_pattern = false;
+    }
+    camera_apply_config(&cfg, NULL);
+}
+
+static void run_camera_verify_regs(void)
+{
+    camera_verify_regs();
+}
+
+static const bench _frame_benches[] = {
+    {"clear_image_buffer",       "pixel", IMAGE_SIZE / 2, run_clear_image_buffer},
+    {"image_fill_uncached",      "pixel", IMAGE_SIZE / 2, run_image_fill_uncached},
+    {"image_fill_cached",        "pixel", IMAGE_SIZE / 2, run_image_fill_cached},
+    {"compare_image_to_default", "pixel", IMAGE_SIZE / 2, run_compare_image_to_default},
+    {"image_compare",            "pixel", IMAGE_SIZE / 2, run_image_compare},
+    {"image_sample_diff",        "pixel", IMAGE_SIZE / 2, run_image_sample_diff},
+    {"rgb565_to_rgb888",         "pixel", IMAGE_SIZE / 2, run_rgb888},
+    {"rgb565_to_rgb888_shift",   "pixel", IMAGE_SIZE / 2, run_rgb888_shift},
+    {"rgb565_to_rgb888_crc32",   "pixel", IMAGE_SIZE / 2, run_rgb888_crc32},
+    {"rgb565_to_rgb888_murmur3", "pixel", IMAGE_SIZE / 2, run_rgb888_murmur3},
+    {"downscale_2x",             "pixel", IMAGE_SIZE / 2, run_downscale_2x},
+    {"downscale_4x",             "pixel", IMAGE_SIZE / 2, run_downscale_4x},
+    {"get_pixel_xy",             "pixel", IMAGE_SIZE / 2, run_get_pixel_xy},
+    {"format_image_xy",          "pixel", BENCH_PRINT_WIDTH * BENCH_PRINT_HEIGHT, run_format_image_xy},
+    {"test_pattern_verify",      "pixel", IMAGE_SIZE / 2, run_test_pattern_verify},
+};
+
+static const bench _i2c_benches[] = {
+    {"camera_setup",             "xfer",  0, run_camera_setup},
+    {"camera_apply_config",      "xfer",  0, run_camera_apply_config},
+    {"camera_verify_regs",       "xfer",  0, run_camera_verify_regs},
+};
+
+#define NB_FRAME_BENCHES    (sizeof(_frame_benches) / sizeof(_frame_benches[0]))
+#define NB_I2C_BENCHES      (sizeof(_i2c_benches) / sizeof(_i2c_benches[0]))
+
+/* Prints x / 1000 with three decimals */
+static void print_milli(uint64_t x)
+{
+    printf(",%lu.%03lu", (unsigned long) (x / 1000), (unsigned long) (x % 1000));
+}
+
+static void bench_one(const bench *b)
+{
+    uint32_t units = b->units;
+    uint32_t min = UINT32_MAX;
+    uint64_t total = 0;
+
+    b->run();
+    if (units == 0) {
+        i2c_reset_stats(_i2c);
+    }
+
+    for (unsigned i = 0; i < BENCH_ITERATIONS; i++) {
+        uint32_t start = cycles_now();
+        b->run();
+        uint32_t cycles = cycles_now() - start;
+
+        total += cycles;
+        if (cycles < min) {
+            min = cycles;
+        }
+    }
+
+    if (units == 0) {
+        units = _i2c->stats.transactions / BENCH_ITERATIONS;
+    }
+
+    uint64_t mean = total / BENCH_ITERATIONS;
+    uint64_t per_unit = units ? total * 1000 / ((uint64_t) BENCH_ITERATIONS * units) : 0;
+
+    printf("bench,%s,%s,%lu,%u,%lu,%lu", b->name, b->unit, (unsigned long) units,
+           BENCH_ITERATIONS, (unsigned long) min, (unsigned long) mean);
+    print_milli(per_unit);
+    print_milli(per_unit * 1000000000 / cycles_freq());
+    print_milli(total ? (uint64_t) BENCH_ITERATIONS * cycles_freq() * 1000 / total : 0);
+    printf("\n");
+}
+
+/* Runs the benchmarks on frame, a buffer of IMAGE_SIZE bytes, and the
+ * register sequence benchmarks on the sensor behind i2c unless it is NULL.
+ * @note overwrites frame and reprograms the sensor (camera interrupt
+ * disabled), call camera_setup() again afterwards.
+ * Returns the number of benchmarks run.
+ */
+unsigned bench_run(uint16_t *frame, i2c_dev *i2c)
+{
+    unsigned n = 0;
+
+    if (!cycles_init()) {
+        printf("bench: no cycle counter, benchmarks skipped\n");
+        return 0;
+    }
+
+    _frame = frame;
+    _i2c = i2c;
+    clear_image_buffer(_frame, BENCH_FILL);
+
+    printf("bench,name,unit,units,iterations,cycles_min,cycles_mean,cycles_per_unit,ns_per_unit,per_s\n");
+    for (unsigned i = 0; i < NB_FRAME_BENCHES; i++, n++) {
+        bench_one(&_frame_benches[i]);
+    }
+    if (i2c != NULL) {
+        for (unsigned i = 0; i < NB_I2C_BENCHES; i++, n++) {
+            bench_one(&_i2c_benches[i]);
+        }
+    }
+    return n;
+}
@@ -0,0 +1,15 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+#include "i2c/i2c.h"
+
+/* Timed iterations of each benchmark */
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 16
+#endif
+
+unsigned bench_run(uint16_t *frame, i2c_dev *i2c);
+
+#endif /* BENCH_H */
@@ -2,21 +2,31 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <system.h>
 #include <sys/alt_irq.h>
 #include <io.h>
 #include "i2c/i2c.h"
+#include "i2c/i2c_queue.h"
 #include "camera.h"
+#include "histogram.h"
 
-/* Settings */
-#define CONFIG_TEST_PATTERN         1
-#define CONFIG_TEST_PATTERN_TYPE    TEST_PATTERN_MONOCHROME_VERTICAL_BARS
-//#define CONFIG_TEST_PATTERN_TYPE    TEST_PATTERN_VERTICAL_COLOR_BARS
-#define CONFIG_BINNING              1
-#define CONFIG_MIRROR_ROW           0
-#define CONFIG_MIRROR_COL           0
-#define CONFIG_PIXCLK_DIV           0 // 0,1,2,4,8,16,32,64 half of effective divider
+/* Settings applied by camera_setup() */
+const camera_config camera_config_default = {
+    .binning = true,
+    .mirror_row = false,
+    .mirror_col = false,
+    .pixclk_div = 0,
+    .test_pattern = true,
+    .test_pattern_type = TEST_PATTERN_MONOCHROME_VERTICAL_BARS,
+    .test_pattern_red = 0x080,
+    .test_pattern_green = 0xfff,
+    .test_pattern_blue = 0xf80,
+    .test_pattern_bar_width = 3,
+    .shutter_width = 3,
+    .vertical_blank = 500, // decrease frame rate
+};
 
 /* Camera Controller peripheral defines */
 #define CAM_BASE CAM_CONTROLLER_0_BASE
@@ -31,107 +41,296 @@
 #define CAM_IMR_IRQ_MASK    0x00000001
 #define CAM_ISR_IRQ_MASK    0x00000001
 
-/* TRDB_D5M Camera defines */
-#define TRDB_D5M_I2C_ADDRESS  (0xba)
-
-/* Register Map */
-#define REG_CHIP_VERSION                0x000   // default: 0x1801
-#define REG_ROW_START                   0x001   // default: 0x0036 (54)
-#define REG_COLUMN_STAR                 0x002   // default: 0x0010 (16)
-#define REG_ROW_SIZE                    0x003   // default: 0x0797 (1943)
-#define REG_COLUMN_SIZE                 0x004   // default: 0x0A1F (2591)
-#define REG_HORIZONTAL_BLANK            0x005   // default: 0x0000 (0)
-#define REG_VERTICAL_BLANK              0x006   // default: 0x0019 (25)
-#define REG_OUTPUT_CONTROL              0x007   // default: 0x1F82
-#define REG_SHUTTER_WIDTH_UPPER         0x008   // default: 0x0000
-#define REG_SHUTTER_WIDTH_LOWER         0x009   // default: 0x0797
-#define REG_PIXEL_CLOCK_CONTROL         0x00A   // default: 0x0000
-#define REG_RESTART                     0x00B   // default: 0x0000
-#define REG_SHUTTER_DELAY               0x00C   // default: 0x0000
-#define REG_RESET                       0x00D   // default: 0x0000
-#define REG_PLL_CONTROL                 0x010   // default: 0x0050
-#define REG_PLL_CONFIG_1                0x011   // default: 0x6404
-#define REG_PLL_CONFIG_2                0x012   // default: 0x0000
-#define REG_READ_MODE_1                 0x01E   // default: 0x4006
-#define REG_READ_MODE_2                 0x020   // default: 0x0007
-#define REG_ROW_ADDRESS_MODE            0x022   // default: 0x8000
-#define REG_COLUMN_ADDRESS_MODE         0x023   // default: 0x0007
-#define REG_GREEN1_GAIN                 0x02B   // default: 0x0007
-#define REG_BLUE_GAIN                   0x02C   // default: 0x0004
-#define REG_RED_GAIN                    0x02D   // default: 0x0001
-#define REG_GREEN2_GAIN                 0x02E   // default: 0x005A
-#define REG_GLOBAL_GAIN                 0x035   // default: 0x231D
-#define REG_ROW_BLACK_TARGET            0x049   // default: 0xA700
-#define REG_ROW_BLACK_DEFAULT_OFFSET    0x04B   // default: 0x0C00
-#define REG_TEST_PATTERN_CONTROL        0x0A0   // default: 0x0000
-#define REG_TEST_PATTERN_GREEN          0x0A1   // default: 0x0000
-#define REG_TEST_PATTERN_RED            0x0A2   // default: 0x0000
-#define REG_TEST_PATTERN_BLUE           0x0A3   // default: 0x0000
-#define REG_TEST_PATTERN_BAR_WIDTH      0x0A4   // default: 0x0000
-#define REG_CHIP_VERSION_ALT            0x0FF   // default: 0x1801
-
-/* Bit position and mask defines */
-/* REG_ROW_ADDRESS_MODE */
-#define ROW_BIN_POS         4
-#define ROW_SKIP_POS        0
-/* REG_COLUMN_ADDRESS_MODE */
-#define COL_BIN_POS         4
-#define COL_SKIP_POS        0
-/* REG_OUTPUT_CONTROL */
-#define CHIP_ENABLE_MASK    (1<<1)
-/* REG_READ_MODE_1 */
-#define SNAPSHOT_MASK       (1<<8)
-/* REG_READ_MODE_2 */
-#define MIRROR_ROW_MASK     (1<<15)
-#define MIRROR_COL_MASK     (1<<14)
-/* REG_PIXEL_CLOCK_CONTROL */
-#define INVERT_PIXCLK_MASK  (1<<15)
-#define DIVIDE_PIXCLK_POS   0
-/* REG_TEST_PATTERN_CONTROL */
-#define TEST_PATTERN_COLOR_FIELD 0
-#define TEST_PATTERN_HORIZONTAL_GRADIENT 1
-#define TEST_PATTERN_VERTICAL_GRADIENT 2
-#define TEST_PATTERN_DIAGONAL 3
-#define TEST_PATTERN_CLASSIC 4
-#define TEST_PATTERN_MARCHING_1S 5
-#define TEST_PATTERN_MONOCHROME_HORIZONTAL_BARS 6
-#define TEST_PATTERN_MONOCHROME_VERTICAL_BARS 7
-#define TEST_PATTERN_VERTICAL_COLOR_BARS 8
-
-#define TEST_PATTERN_CONTROL_POS 3
-#define ENABLE_TEST_PATTERN_MASK (1<<0)
+static i2c_dev *_i2c;
+static i2c_queue *_i2c_queue;
+static uint32_t (*_timestamp)(void);
 
+/* User interrupt handler, called through camera_isr() */
+static void (*_isr)(void *);
+static void *_isr_arg;
 
-static i2c_dev *_i2c;
+/* IRQ instrumentation, in units of the timestamp source */
+static volatile uint32_t _irq_timestamp;    /* entry time of the current IRQ */
+static uint32_t _irq_last;                  /* entry time of the previous IRQ */
+static bool _irq_seen;
+static histogram _isr_duration;
+static histogram _frame_interval;
+
+
+
+/* Registers printed by camera_dump_regs(), sorted by address */
+#define DUMP_REG(name) {REG_ ## name, #name}
+
+static const struct {
+    uint8_t reg;
+    const char *name;
+} _dump_regs[] = {
+    DUMP_REG(CHIP_VERSION),
+    DUMP_REG(ROW_START),
+    DUMP_REG(COLUMN_STAR),
+    DUMP_REG(ROW_SIZE),
+    DUMP_REG(COLUMN_SIZE),
+    DUMP_REG(HORIZONTAL_BLANK),
+    DUMP_REG(VERTICAL_BLANK),
+    DUMP_REG(OUTPUT_CONTROL),
+    DUMP_REG(SHUTTER_WIDTH_UPPER),
+    DUMP_REG(SHUTTER_WIDTH_LOWER),
+    DUMP_REG(PIXEL_CLOCK_CONTROL),
+    DUMP_REG(RESTART),
+    DUMP_REG(SHUTTER_DELAY),
+    DUMP_REG(RESET),
+    DUMP_REG(PLL_CONTROL),
+    DUMP_REG(PLL_CONFIG_1),
+    DUMP_REG(PLL_CONFIG_2),
+    DUMP_REG(READ_MODE_1),
+    DUMP_REG(READ_MODE_2),
+    DUMP_REG(ROW_ADDRESS_MODE),
+    DUMP_REG(COLUMN_ADDRESS_MODE),
+    DUMP_REG(GREEN1_GAIN),
+    DUMP_REG(BLUE_GAIN),
+    DUMP_REG(RED_GAIN),
+    DUMP_REG(GREEN2_GAIN),
+    DUMP_REG(GLOBAL_GAIN),
+    DUMP_REG(ROW_BLACK_TARGET),
+    DUMP_REG(ROW_BLACK_DEFAULT_OFFSET),
+    DUMP_REG(TEST_PATTERN_CONTROL),
+    DUMP_REG(TEST_PATTERN_GREEN),
+    DUMP_REG(TEST_PATTERN_RED),
+    DUMP_REG(TEST_PATTERN_BLUE),
+    DUMP_REG(TEST_PATTERN_BAR_WIDTH),
+    DUMP_REG(CHIP_VERSION_ALT),
+};
+
+#define NB_DUMP_REGS (sizeof(_dump_regs) / sizeof(_dump_regs[0]))
+
+/* Shadow register file
+ *
+ * Copy of the sensor registers, loaded by shadow_load() and updated on every
+ * successful camera_write_regs(), so that read-modify-write sequences and the
+ * IRQ handler do not need I2C reads.
+ * Registers with self-clearing bits are never cached.
+ */
+#define SHADOW_NB_REGS  256
 
-static bool write_reg(uint8_t register_offset, uint16_t data)
+static uint16_t _shadow[SHADOW_NB_REGS];
+static uint32_t _shadow_valid[SHADOW_NB_REGS / 32];
+
+/* Longest register span read in one I2C transaction */
+#define READ_MAX_SPAN   16
+/* Unused registers read to merge two spans, cheaper than a new addressing phase */
+#define READ_MAX_GAP    2
+
+static bool shadow_cacheable(uint8_t register_offset)
 {
-    int success;
-    uint8_t byte_data[2] = {(data >> 8) & 0xff, data & 0xff};
+    return register_offset != REG_RESTART && register_offset != REG_RESET;
+}
 
-    success = i2c_write_array(_i2c, TRDB_D5M_I2C_ADDRESS, register_offset, byte_data, sizeof(byte_data));
+static bool shadow_is_valid(uint8_t register_offset)
+{
+    return _shadow_valid[register_offset / 32] & (1u << (register_offset % 32));
+}
 
-    if (success != I2C_SUCCESS) {
-        return false;
-    } else {
-        return true;
+static void shadow_set(uint8_t register_offset, uint16_t data)
+{
+    if (!shadow_cacheable(register_offset)) {
+        return;
     }
+    _shadow[register_offset] = data;
+    _shadow_valid[register_offset / 32] |= 1u << (register_offset % 32);
 }
 
-static uint16_t read_reg(uint8_t register_offset)
+static void shadow_invalidate(void)
 {
-    int success;
-    uint8_t byte_data[2] = {0, 0};
+    for (unsigned i = 0; i < SHADOW_NB_REGS / 32; i++) {
+        _shadow_valid[i] = 0;
+    }
+}
+
+/* Sensor I2C transactions, through the transaction queue at low priority
+ * if one is set with camera_set_i2c_queue().
+ */
+static int sensor_transfer(uint8_t index, uint8_t *data, unsigned size, bool read)
+{
+    if (_i2c_queue == NULL) {
+        if (read) {
+            return i2c_read_array(_i2c, TRDB_D5M_I2C_ADDRESS, index, data, size);
+        }
+        return i2c_write_array(_i2c, TRDB_D5M_I2C_ADDRESS, index, data, size);
+    }
+
+    i2c_transfer xfer = {
+        .device = TRDB_D5M_I2C_ADDRESS,
+        .index = index,
+        .read = read,
+        .data = data,
+        .size = size,
+    };
+    return i2c_queue_run(_i2c_queue, &xfer, I2C_QUEUE_PRIO_LOW);
+}
+
+static int sensor_read(uint8_t index, uint8_t *data, unsigned size)
+{
+    return sensor_transfer(index, data, size, true);
+}
+
+static int sensor_write(uint8_t index, uint8_t *data, unsigned size)
+{
+    return sensor_transfer(index, data, size, false);
+}
+
+/* Reads count consecutive registers, READ_MAX_SPAN registers per I2C
+ * transaction using the sensor's register address auto-increment.
+ * Returns I2C_SUCCESS or the I2C error code.
+ */
+int camera_read_regs(uint8_t first, unsigned count, uint16_t *data)
+{
+    uint8_t byte_data[2 * READ_MAX_SPAN];
+
+    while (count > 0) {
+        unsigned n = count < READ_MAX_SPAN ? count : READ_MAX_SPAN;
 
-    success = i2c_read_array(_i2c, TRDB_D5M_I2C_ADDRESS, register_offset, byte_data, sizeof(byte_data));
+        int status = sensor_read(first, byte_data, 2 * n);
+        if (status != I2C_SUCCESS) {
+            printf("ERROR: I2C read of register %#x: error %d\n", first, status);
+            return status;
+        }
+        for (unsigned i = 0; i < n; i++) {
+            data[i] = ((uint16_t) byte_data[2*i] << 8) + byte_data[2*i + 1];
+        }
 
-    if (success != I2C_SUCCESS) {
-    	printf("ERROR: I2C read\n");
+        first += n;
+        data += n;
+        count -= n;
     }
+    return I2C_SUCCESS;
+}
+
+/* Reads a register, from the shadow copy if it is valid.
+ * Returns I2C_SUCCESS or the I2C error code.
+ */
+static int read_reg(uint8_t register_offset, uint16_t *value)
+{
+    if (shadow_is_valid(register_offset)) {
+        *value = _shadow[register_offset];
+        return I2C_SUCCESS;
+    }
+
+    int status = camera_read_regs(register_offset, 1, value);
+    if (status == I2C_SUCCESS) {
+        shadow_set(register_offset, *value);
+    }
+    return status;
+}
+
+/* Reads all _dump_regs from the sensor into values. Neighbouring registers
+ * are merged into spans, so only isolated registers need their own
+ * transaction.
+ */
+static int read_dump_regs(uint16_t *values)
+{
+    uint16_t span[READ_MAX_SPAN];
+    unsigned i = 0;
+
+    while (i < NB_DUMP_REGS) {
+        uint8_t first = _dump_regs[i].reg;
+        unsigned last = i;
 
-    return ((uint16_t) byte_data[0] << 8) + byte_data[1];
+        while (last + 1 < NB_DUMP_REGS
+               && _dump_regs[last + 1].reg - _dump_regs[last].reg <= READ_MAX_GAP + 1
+               && _dump_regs[last + 1].reg - first < READ_MAX_SPAN) {
+            last++;
+        }
+
+        int status = camera_read_regs(first, _dump_regs[last].reg - first + 1, span);
+        if (status != I2C_SUCCESS) {
+            return status;
+        }
+        for (; i <= last; i++) {
+            values[i] = span[_dump_regs[i].reg - first];
+        }
+    }
+    return I2C_SUCCESS;
 }
 
+/* Loads the shadow register file with burst reads.
+ * Returns I2C_SUCCESS or the I2C error code.
+ */
+static int shadow_load(void)
+{
+    uint16_t values[NB_DUMP_REGS];
+
+    shadow_invalidate();
+    int status = read_dump_regs(values);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
+    for (unsigned i = 0; i < NB_DUMP_REGS; i++) {
+        shadow_set(_dump_regs[i].reg, values[i]);
+    }
+    return I2C_SUCCESS;
+}
+
+/* Longest register run written in one I2C transaction */
+#define WRITE_MAX_SPAN  16
+
+/* Execute a register write sequence.
+ * Entries with consecutive register addresses and no delay are coalesced
+ * into one I2C transaction using the sensor's register address
+ * auto-increment. Masked entries are merged with the shadow copy.
+ * Returns I2C_SUCCESS or the error of the first failing transaction, in
+ * which case *failed (if not NULL) holds the index of its first entry.
+ */
+int camera_write_regs(const camera_reg_write *seq, unsigned n, unsigned *failed)
+{
+    uint8_t byte_data[2 * WRITE_MAX_SPAN];
+    unsigned i = 0;
+
+    while (i < n) {
+        uint8_t first = seq[i].reg;
+        unsigned count = 0;
+
+        do {
+            const camera_reg_write *w = &seq[i + count];
+            uint16_t value = w->value;
+
+            if (w->mask != 0xffff) {
+                uint16_t reg;
+                int status = read_reg(w->reg, &reg);
+                if (status != I2C_SUCCESS) {
+                    if (failed != NULL) {
+                        *failed = i + count;
+                    }
+                    return status;
+                }
+                value = (reg & ~w->mask) | (value & w->mask);
+            }
+            byte_data[2*count] = (value >> 8) & 0xff;
+            byte_data[2*count + 1] = value & 0xff;
+            count++;
+        } while (i + count < n
+                 && count < WRITE_MAX_SPAN
+                 && seq[i + count - 1].delay_us == 0
+                 && seq[i + count].reg == first + count);
+
+        int status = sensor_write(first, byte_data, 2 * count);
+        if (status != I2C_SUCCESS) {
+            if (failed != NULL) {
+                *failed = i;
+            }
+            return status;
+        }
+
+        for (unsigned j = 0; j < count; j++) {
+            shadow_set(first + j, ((uint16_t) byte_data[2*j] << 8) | byte_data[2*j + 1]);
+        }
+
+        i += count;
+        if (seq[i - 1].delay_us != 0) {
+            usleep(seq[i - 1].delay_us);
+        }
+    }
+    return I2C_SUCCESS;
+}
 
 void camera_enable(void)
 {
@@ -145,6 +344,7 @@ void camera_enable(void)
 void camera_disable(void)
 {
     IOWR_32DIRECT(CAM_BASE, CAM_CR, 0);
+    shadow_invalidate();
 }
 
 void camera_enable_receive(void)
@@ -183,22 +383,284 @@ void camera_disable_interrupt(void)
 // NIOS-II BSP generator gives wrong IRQ numbers (-1). Override by hand using number from Qsys
 #define CAM_IC_ID 0
 #define CAM_IRQ 1
+
+/* Route sensor I2C accesses through a transaction queue, so that
+ * camera_update_exposure() can preempt long register sequences.
+ * @note the queue must be initialized on the i2c device given to camera_setup().
+ */
+void camera_set_i2c_queue(i2c_queue *queue)
+{
+    _i2c_queue = queue;
+}
+
+/* Configuration registers
+ *
+ * Register values derived from a camera_config, in programming order.
+ * The values of the last applied configuration are kept so that
+ * camera_apply_config() only writes registers that change.
+ */
+#define CONFIG_NB_REGS  14
+
+static camera_reg_write _config_regs[CONFIG_NB_REGS];
+static bool _config_valid;
+static camera_config _config;
+
+/* Keeps the last applied configuration in line with a register written
+ * outside of camera_apply_config(), e.g. by camera_update_exposure(), so
+ * that the next camera_apply_config() does not skip it.
+ */
+static void config_reg_update(uint8_t reg, uint16_t value)
+{
+    for (unsigned i = 0; i < CONFIG_NB_REGS; i++) {
+        if (_config_regs[i].reg == reg && _config_regs[i].mask == 0xffff) {
+            _config_regs[i].value = value;
+        }
+    }
+    if (reg == REG_SHUTTER_WIDTH_LOWER) {
+        _config.shutter_width = (_config.shutter_width & 0xffff0000) | value;
+    }
+}
+
+#define CONFIG_REG(r, v)            ((camera_reg_write) {(r), 0xffff, (v), 0})
+#define CONFIG_REG_MASKED(r, m, v)  ((camera_reg_write) {(r), (m), (v), 0})
+
+static void config_to_regs(const camera_config *cfg, camera_reg_write *regs)
+{
+    unsigned i = 0;
+
+    if (cfg->binning) {
+        // See "Table 1.7 Standard Resolutions" in THDB-D5 Hardware Specification.
+        regs[i++] = CONFIG_REG(REG_ROW_SIZE, 1919);
+        regs[i++] = CONFIG_REG(REG_COLUMN_SIZE, 2559);
+    } else {
+        regs[i++] = CONFIG_REG(REG_ROW_SIZE, 479);
+        regs[i++] = CONFIG_REG(REG_COLUMN_SIZE, 640);
+    }
+
+    regs[i++] = CONFIG_REG(REG_VERTICAL_BLANK, cfg->vertical_blank);
+
+    regs[i++] = CONFIG_REG(REG_SHUTTER_WIDTH_UPPER, cfg->shutter_width >> 16);
+    regs[i++] = CONFIG_REG(REG_SHUTTER_WIDTH_LOWER, cfg->shutter_width & 0xffff);
+
+    // invert clock
+    regs[i++] = CONFIG_REG(REG_PIXEL_CLOCK_CONTROL, INVERT_PIXCLK_MASK | (cfg->pixclk_div<<DIVIDE_PIXCLK_POS));
+
+    // mirror image
+    uint16_t mirror = 0;
+    if (cfg->mirror_row) {
+        mirror |= MIRROR_ROW_MASK;
+    }
+    if (cfg->mirror_col) {
+        mirror |= MIRROR_COL_MASK;
+    }
+    regs[i++] = CONFIG_REG_MASKED(REG_READ_MODE_2, MIRROR_ROW_MASK | MIRROR_COL_MASK, mirror);
+
+    // ROW_BIN (R0x22 [5:4]), ROW_SKIP (R0x22 [2:0])
+    // COLUMN_BIN (R0x23 [5:4]), COLUMN_SKIP (R0x23 [2:0])
+    uint16_t bin = cfg->binning ? 3 : 0;
+    regs[i++] = CONFIG_REG(REG_ROW_ADDRESS_MODE, (bin<<ROW_BIN_POS) | (bin<<ROW_SKIP_POS));
+    regs[i++] = CONFIG_REG(REG_COLUMN_ADDRESS_MODE, (bin<<COL_BIN_POS) | (bin<<COL_SKIP_POS));
+
+    // Test_Pattern_Mode
+    uint16_t test_pattern = 0;
+    if (cfg->test_pattern) {
+        test_pattern = ENABLE_TEST_PATTERN_MASK | (cfg->test_pattern_type<<TEST_PATTERN_CONTROL_POS);
+    }
+    regs[i++] = CONFIG_REG(REG_TEST_PATTERN_CONTROL, test_pattern);
+    regs[i++] = CONFIG_REG(REG_TEST_PATTERN_GREEN, cfg->test_pattern_green);
+    regs[i++] = CONFIG_REG(REG_TEST_PATTERN_RED, cfg->test_pattern_red);
+    regs[i++] = CONFIG_REG(REG_TEST_PATTERN_BLUE, cfg->test_pattern_blue);
+    regs[i++] = CONFIG_REG(REG_TEST_PATTERN_BAR_WIDTH, cfg->test_pattern_bar_width);
+}
+
+/* Apply a camera configuration at runtime.
+ * Only the registers that differ from the last applied configuration are
+ * written, merged into as few I2C transactions as possible; their number is
+ * returned in *writes (if not NULL).
+ * Returns I2C_SUCCESS or the I2C error code.
+ * @note camera_setup() must have been called before.
+ * @note disabling binning changes the output resolution.
+ */
+int camera_apply_config(const camera_config *cfg, unsigned *writes)
+{
+    camera_reg_write regs[CONFIG_NB_REGS];
+    camera_reg_write changed[CONFIG_NB_REGS];
+    unsigned n = 0;
+    unsigned failed;
+
+    config_to_regs(cfg, regs);
+
+    for (unsigned i = 0; i < CONFIG_NB_REGS; i++) {
+        if (!_config_valid || regs[i].value != _config_regs[i].value) {
+            changed[n++] = regs[i];
+        }
+    }
+
+    int status = camera_write_regs(changed, n, &failed);
+    if (status != I2C_SUCCESS) {
+        printf("ERROR: camera config, register %#x: I2C error %d\n", changed[failed].reg, status);
+        _config_valid = false;
+        return status;
+    }
+
+    for (unsigned i = 0; i < CONFIG_NB_REGS; i++) {
+        _config_regs[i] = regs[i];
+    }
+    _config = *cfg;
+    _config_valid = true;
+    if (writes != NULL) {
+        *writes = n;
+    }
+    return I2C_SUCCESS;
+}
+
+/* Returns the last applied configuration, including the shutter width set
+ * by camera_update_exposure().
+ */
+const camera_config *camera_get_config(void)
+{
+    return &_config;
+}
+
+/* Exposure update, one high priority transaction per register */
+static struct {
+    i2c_transfer xfer[2];
+    uint8_t data[2][2];
+} _exposure_update;
+
+static void exposure_update_done(i2c_transfer *xfer, int status)
+{
+    if (status == I2C_SUCCESS) {
+        uint16_t value = ((uint16_t) xfer->data[0] << 8) | xfer->data[1];
+        shadow_set(xfer->index, value);
+        config_reg_update(xfer->index, value);
+    } else {
+        /* register state unknown, rewrite the whole configuration */
+        _config_valid = false;
+    }
+}
+
+/* Queue a shutter width and global gain update ahead of any pending low
+ * priority transaction, so that it lands within the current vertical blank.
+ * Returns false if no queue is set or the previous update is still pending.
+ * @note safe to call from the camera interrupt handler.
+ */
+bool camera_update_exposure(uint16_t shutter_width_lower, uint16_t global_gain)
+{
+    static const uint8_t regs[2] = {REG_SHUTTER_WIDTH_LOWER, REG_GLOBAL_GAIN};
+    uint16_t values[2] = {shutter_width_lower, global_gain};
+
+    if (_i2c_queue == NULL) {
+        return false;
+    }
+    for (unsigned i = 0; i < 2; i++) {
+        if (_exposure_update.xfer[i].status == I2C_EBUSY) {
+            return false;
+        }
+    }
+
+    for (unsigned i = 0; i < 2; i++) {
+        _exposure_update.data[i][0] = values[i] >> 8;
+        _exposure_update.data[i][1] = values[i] & 0xff;
+        _exposure_update.xfer[i] = (i2c_transfer) {
+            .device = TRDB_D5M_I2C_ADDRESS,
+            .index = regs[i],
+            .data = _exposure_update.data[i],
+            .size = 2,
+            .callback = exposure_update_done,
+        };
+        i2c_queue_submit(_i2c_queue, &_exposure_update.xfer[i], I2C_QUEUE_PRIO_HIGH);
+    }
+    return true;
+}
+
+/* Camera interrupt entry, times the user handler */
+static void camera_isr(void *arg)
+{
+    (void) arg;
+
+    if (_timestamp == NULL) {
+        _irq_timestamp = 0;
+        _isr(_isr_arg);
+        return;
+    }
+
+    uint32_t entry = _timestamp();
+    _irq_timestamp = entry;
+    if (_irq_seen) {
+        histogram_add(&_frame_interval, entry - _irq_last);
+    }
+    _irq_last = entry;
+    _irq_seen = true;
+
+    _isr(_isr_arg);
+
+    histogram_add(&_isr_duration, _timestamp() - entry);
+}
+
+/* Reset the IRQ duration and frame interval statistics. */
+void camera_stats_reset(void)
+{
+    alt_ic_irq_disable(CAM_IC_ID, CAM_IRQ);
+    histogram_reset(&_isr_duration);
+    histogram_reset(&_frame_interval);
+    _irq_seen = false;
+    alt_ic_irq_enable(CAM_IC_ID, CAM_IRQ);
+}
+
+/* Print the IRQ duration and frame interval statistics. */
+void camera_stats_dump(void)
+{
+    histogram isr_duration, frame_interval;
+
+    alt_ic_irq_disable(CAM_IC_ID, CAM_IRQ);
+    isr_duration = _isr_duration;
+    frame_interval = _frame_interval;
+    alt_ic_irq_enable(CAM_IC_ID, CAM_IRQ);
+
+    histogram_print("camera ISR duration", &isr_duration);
+    histogram_print("camera frame interval", &frame_interval);
+}
+
+/* Register sequence executed by camera_setup() before the configuration */
+static const camera_reg_write _setup_seq[] = {
+    // clear the bit Snapshot in register Read Mode 1 (bit 8 in R0x1E)
+    {REG_READ_MODE_1, SNAPSHOT_MASK, 0, 0},
+};
+
+#define NB_SETUP_SEQ (sizeof(_setup_seq) / sizeof(_setup_seq[0]))
+
+/* Register sequence executed by camera_setup() after the configuration */
+static const camera_reg_write _enable_seq = {REG_OUTPUT_CONTROL, CHIP_ENABLE_MASK, CHIP_ENABLE_MASK, 0};
+
 /* Setup the camera
+ * Returns I2C_SUCCESS or the error of the first failing I2C transaction, in
+ * which case the sensor is left half configured with receive disabled.
  * @note isr can be NULL to disable the interrupt
  */
-void camera_setup(i2c_dev *i2c, uint16_t *buf, void (*isr)(void *), void *isr_arg)
+int camera_setup(i2c_dev *i2c, uint16_t *buf, void (*isr)(void *), void *isr_arg)
 {
-    uint16_t reg;
     _i2c = i2c;
 
+    int status = shadow_load();
+    if (status != I2C_SUCCESS) {
+        printf("ERROR: camera setup, register load: I2C error %d\n", status);
+        return status;
+    }
 
     uint32_t cam_cr = _camera_disable_receive();
 
     camera_clear_irq_flag();
+    histogram_reset(&_isr_duration);
+    histogram_reset(&_frame_interval);
+    _irq_seen = false;
+
     if (isr != NULL) {
         // ic_id = <MY_IP>_IRQ_INTERRUPT_CONTROLLER_ID
         // irq = <MY_IP>_IRQ
-        alt_ic_isr_register(CAM_IC_ID, CAM_IRQ, isr, isr_arg, NULL);
+        _isr = isr;
+        _isr_arg = isr_arg;
+        alt_ic_isr_register(CAM_IC_ID, CAM_IRQ, camera_isr, NULL, NULL);
         alt_ic_irq_enable(CAM_IC_ID, CAM_IRQ);
 
         camera_enable_interrupt();
@@ -206,76 +668,31 @@ void camera_setup(i2c_dev *i2c, uint16_t *buf, void (*isr)(void *), void *isr_ar
         camera_disable_interrupt();
     }
 
-#if CONFIG_BINNING
-    // See "Table 1.7 Standard Resolutions" in THDB-D5 Hardware Specification.
-
-    // ROW_SIZE = 1919 (R0x03)
-    write_reg(REG_ROW_SIZE, 1919);
-    // COLUMN_SIZE = 2559 (R0x04)
-    write_reg(REG_COLUMN_SIZE, 2559);
-    // SHUTTER_WIDTH_LOWER = 3 (R0x09)
-    write_reg(REG_SHUTTER_WIDTH_LOWER, 3);
-    write_reg(REG_SHUTTER_WIDTH_UPPER, 0);
-    // ROW_BIN = 3 (R0x22 [5:4])
-    // ROW_SKIP = 3 (R0x22 [2:0])
-    write_reg(REG_ROW_ADDRESS_MODE, (3<<ROW_BIN_POS) | (3<<ROW_SKIP_POS));
-    // COLUMN_BIN = 3 (R0x23 [5:4])
-    // COLUMN_SKIP = 3 (R0x23 [2:0])
-    write_reg(REG_COLUMN_ADDRESS_MODE, (3<<COL_BIN_POS) | (3<<COL_SKIP_POS));
-#else
-    // ROW_SIZE = 479 (R0x03)
-    write_reg(REG_ROW_SIZE, 479);
-    // COLUMN_SIZE = 640 (R0x04)
-    write_reg(REG_COLUMN_SIZE, 640);
-    // SHUTTER_WIDTH_LOWER < 479 (R0x09)
-    write_reg(REG_SHUTTER_WIDTH_LOWER, 3);
-    write_reg(REG_SHUTTER_WIDTH_UPPER, 0);
-    // ROW_BIN = 0 (R0x22 [5:4])
-    // ROW_SKIP = 0 (R0x22 [2:0])
-    write_reg(REG_ROW_ADDRESS_MODE, (0<<ROW_BIN_POS) | (0<<ROW_SKIP_POS));
-    // COLUMN_BIN = 0 (R0x23 [5:4])
-    // COLUMN_SKIP = 0 (R0x23 [2:0])
-    write_reg(REG_COLUMN_ADDRESS_MODE, (0<<COL_BIN_POS) | (0<<COL_SKIP_POS));
-#endif
-
-    // clear the bit Snapshot in register Read Mode 1 (bit 8 in R0x1E)
-    reg = read_reg(REG_READ_MODE_1);
-    write_reg(REG_READ_MODE_1, reg & ~SNAPSHOT_MASK);
-
-    // decrease frame rate
-    write_reg(REG_VERTICAL_BLANK, 500);
-
-    // mirror image
-    reg = read_reg(REG_READ_MODE_2);
-    reg &= ~(MIRROR_ROW_MASK | MIRROR_COL_MASK);
-#if CONFIG_MIRROR_ROW
-    reg |= MIRROR_ROW_MASK;
-#endif
-#if CONFIG_MIRROR_COL
-    reg |= MIRROR_COL_MASK;
-#endif
-    write_reg(REG_READ_MODE_2, reg);
-
-    // invert clock
-    write_reg(REG_PIXEL_CLOCK_CONTROL, INVERT_PIXCLK_MASK | (CONFIG_PIXCLK_DIV<<DIVIDE_PIXCLK_POS));
+    unsigned failed;
+    status = camera_write_regs(_setup_seq, NB_SETUP_SEQ, &failed);
+    if (status != I2C_SUCCESS) {
+        printf("ERROR: camera setup, register %#x: I2C error %d\n", _setup_seq[failed].reg, status);
+        return status;
+    }
 
-#if CONFIG_TEST_PATTERN
-    // Test_Pattern_Mode
-    write_reg(REG_TEST_PATTERN_CONTROL, ENABLE_TEST_PATTERN_MASK | (CONFIG_TEST_PATTERN_TYPE<<TEST_PATTERN_CONTROL_POS));
-    write_reg(REG_TEST_PATTERN_RED, 0x080);
-    write_reg(REG_TEST_PATTERN_GREEN, 0xfff);
-    write_reg(REG_TEST_PATTERN_BLUE, 0xf80);
-    write_reg(REG_TEST_PATTERN_BAR_WIDTH, 3);
-#endif
+    _config_valid = false;
+    status = camera_apply_config(&camera_config_default, NULL);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     // Chip Enable=1 in Output Control register (bit 2 in R0x07)
-    reg = read_reg(REG_OUTPUT_CONTROL);
-    write_reg(REG_OUTPUT_CONTROL, reg | CHIP_ENABLE_MASK);
+    status = camera_write_regs(&_enable_seq, 1, NULL);
+    if (status != I2C_SUCCESS) {
+        printf("ERROR: camera enable: I2C error %d\n", status);
+        return status;
+    }
 
     camera_set_frame_buffer(buf);
 
     // restore Camera Control Register
     IOWR_32DIRECT(CAM_BASE, CAM_CR, cam_cr);
+    return I2C_SUCCESS;
 }
 
 bool camera_image_received(void)
@@ -299,43 +716,367 @@ void camera_set_frame_buffer(uint16_t *buf)
 
 uint16_t *camera_get_frame_buffer(void)
 {
-    return (uint16_t *) IORD_32DIRECT(CAM_BASE, CAM_IAR);
-}
-
-void camera_dump_regs(void)
-{
-    printf("CHIP_VERSION = %4hx\n", read_reg(REG_CHIP_VERSION));
-    printf("ROW_START = %4hx\n", read_reg(REG_ROW_START));
-    printf("COLUMN_STAR = %4hx\n", read_reg(REG_COLUMN_STAR));
-    printf("ROW_SIZE = %4hx\n", read_reg(REG_ROW_SIZE));
-    printf("COLUMN_SIZE = %4hx\n", read_reg(REG_COLUMN_SIZE));
-    printf("HORIZONTAL_BLANK = %4hx\n", read_reg(REG_HORIZONTAL_BLANK));
-    printf("VERTICAL_BLANK = %4hx\n", read_reg(REG_VERTICAL_BLANK));
-    printf("OUTPUT_CONTROL = %4hx\n", read_reg(REG_OUTPUT_CONTROL));
-    printf("SHUTTER_WIDTH_UPPER = %4hx\n", read_reg(REG_SHUTTER_WIDTH_UPPER));
-    printf("SHUTTER_WIDTH_LOWER = %4hx\n", read_reg(REG_SHUTTER_WIDTH_LOWER));
-    printf("PIXEL_CLOCK_CONTROL = %4hx\n", read_reg(REG_PIXEL_CLOCK_CONTROL));
-    printf("RESTART = %4hx\n", read_reg(REG_RESTART));
-    printf("SHUTTER_DELAY = %4hx\n", read_reg(REG_SHUTTER_DELAY));
-    printf("RESET = %4hx\n", read_reg(REG_RESET));
-    printf("PLL_CONTROL = %4hx\n", read_reg(REG_PLL_CONTROL));
-    printf("PLL_CONFIG_1 = %4hx\n", read_reg(REG_PLL_CONFIG_1));
-    printf("PLL_CONFIG_2 = %4hx\n", read_reg(REG_PLL_CONFIG_2));
-    printf("READ_MODE_1 = %4hx\n", read_reg(REG_READ_MODE_1));
-    printf("READ_MODE_2 = %4hx\n", read_reg(REG_READ_MODE_2));
-    printf("ROW_ADDRESS_MODE = %4hx\n", read_reg(REG_ROW_ADDRESS_MODE));
-    printf("COLUMN_ADDRESS_MODE = %4hx\n", read_reg(REG_COLUMN_ADDRESS_MODE));
-    printf("GREEN1_GAIN = %4hx\n", read_reg(REG_GREEN1_GAIN));
-    printf("BLUE_GAIN = %4hx\n", read_reg(REG_BLUE_GAIN));
-    printf("RED_GAIN = %4hx\n", read_reg(REG_RED_GAIN));
-    printf("GREEN2_GAIN = %4hx\n", read_reg(REG_GREEN2_GAIN));
-    printf("GLOBAL_GAIN = %4hx\n", read_reg(REG_GLOBAL_GAIN));
-    printf("ROW_BLACK_TARGET = %4hx\n", read_reg(REG_ROW_BLACK_TARGET));
-    printf("ROW_BLACK_DEFAULT_OFFSET = %4hx\n", read_reg(REG_ROW_BLACK_DEFAULT_OFFSET));
-    printf("TEST_PATTERN_CONTROL = %4hx\n", read_reg(REG_TEST_PATTERN_CONTROL));
-    printf("TEST_PATTERN_GREEN = %4hx\n", read_reg(REG_TEST_PATTERN_GREEN));
-    printf("TEST_PATTERN_RED = %4hx\n", read_reg(REG_TEST_PATTERN_RED));
-    printf("TEST_PATTERN_BLUE = %4hx\n", read_reg(REG_TEST_PATTERN_BLUE));
-    printf("TEST_PATTERN_BAR_WIDTH = %4hx\n", read_reg(REG_TEST_PATTERN_BAR_WIDTH));
-    printf("CHIP_VERSION_ALT = %4hx\n", read_reg(REG_CHIP_VERSION_ALT));
+    return (uint16_t *) (uintptr_t) IORD_32DIRECT(CAM_BASE, CAM_IAR);
+}
+
+/* Print the sensor registers, read with burst transactions.
+ * The shadow copy is refreshed with the values read.
+ * Returns I2C_SUCCESS or the I2C error code, nothing is printed on error.
+ */
+int camera_dump_regs(void)
+{
+    uint16_t values[NB_DUMP_REGS];
+
+    int status = read_dump_regs(values);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
+    for (unsigned i = 0; i < NB_DUMP_REGS; i++) {
+        printf("%s = %4hx\n", _dump_regs[i].name, values[i]);
+        shadow_set(_dump_regs[i].reg, values[i]);
+    }
+    return I2C_SUCCESS;
+}
+
+/* Compare the shadow copy against the sensor registers.
+ * Returns the number of mismatching registers, all of them on I2C error.
+ */
+unsigned camera_verify_regs(void)
+{
+    uint16_t values[NB_DUMP_REGS];
+    unsigned mismatches = 0;
+
+    if (read_dump_regs(values) != I2C_SUCCESS) {
+        return NB_DUMP_REGS;
+    }
+
+    for (unsigned i = 0; i < NB_DUMP_REGS; i++) {
+        uint8_t reg = _dump_regs[i].reg;
+
+        if (!shadow_cacheable(reg) || !shadow_is_valid(reg)) {
+            continue;
+        }
+        if (values[i] != _shadow[reg]) {
+            printf("%s: shadow %4hx, sensor %4hx\n", _dump_regs[i].name, _shadow[reg], values[i]);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+/* Set the function used to timestamp received frames.
+ * @note now is called from interrupt context, NULL disables timestamps.
+ */
+void camera_set_timestamp_source(uint32_t (*now)(void))
+{
+    _timestamp = now;
+}
+
+/* Frame queue
+ *
+ * Ring of n frame buffers. head is only written by the IRQ handler and tail
+ * only by the consumer, so no locking is needed on a single core.
+ * frames[head % n] is the current DMA target, frames[tail % n] ..
+ * frames[head-1 % n] hold received frames waiting to be consumed, the first
+ * one held by the consumer between camera_queue_get() and
+ * camera_queue_release() (held set).
+ *
+ * In continuous mode the controller is never stopped and the queue stays
+ * current: when no buffer is free, the IRQ drops the oldest waiting frame
+ * (never the held one), shifts the newer ones down and reuses its buffer
+ * as DMA target. Only if no frame is waiting besides the held one (n == 2)
+ * is the new frame dropped instead, the DMA target being overwritten.
+ *
+ * In CAMERA_INTEGRITY_CANARY mode free buffers get CAMERA_CANARY_VALUE
+ * written to a few pixels of the first and last rows and of every
+ * CAMERA_CANARY_ROW_STRIDE-th row (first, middle and last column). The IRQ
+ * counts the canaries the DMA left in place into frame->canaries: a few
+ * dozen accesses per frame instead of filling and scanning whole frames.
+ * A frame overwriting a dropped one in the DMA target is only checked
+ * against the canaries of the first. A pixel that happens to hold
+ * CAMERA_CANARY_VALUE counts as a canary left in place.
+ */
+static struct {
+    camera_frame frames[CAMERA_QUEUE_MAX_FRAMES];
+    unsigned n;
+    camera_queue_mode mode;
+    camera_integrity integrity;
+    volatile unsigned head;
+    volatile unsigned tail;
+    volatile bool held;     /* frames[tail % n] is held by the consumer */
+    volatile bool stalled;  /* receive disabled because no buffer was free */
+    volatile uint32_t received;
+    volatile uint32_t dropped;
+    uint32_t dropped_since_last;
+} _queue;
+
+static const uint16_t _canary_columns[] = {0, IMAGE_WIDTH / 2, IMAGE_WIDTH - 1};
+
+#define NB_CANARY_COLUMNS (sizeof(_canary_columns) / sizeof(_canary_columns[0]))
+
+/* Canary row following row, IMAGE_HEIGHT after the last one */
+static unsigned canary_next_row(unsigned row)
+{
+    if (row == IMAGE_HEIGHT - 1) {
+        return IMAGE_HEIGHT;
+    }
+    row += CAMERA_CANARY_ROW_STRIDE;
+    return row < IMAGE_HEIGHT ? row : IMAGE_HEIGHT - 1;
+}
+
+static void canary_arm(uint16_t *buf)
+{
+    for (unsigned row = 0; row < IMAGE_HEIGHT; row = canary_next_row(row)) {
+        for (unsigned i = 0; i < NB_CANARY_COLUMNS; i++) {
+            IOWR_16DIRECT(buf, 2 * (row * IMAGE_WIDTH + _canary_columns[i]), CAMERA_CANARY_VALUE);
+        }
+    }
+}
+
+/* Returns the number of canaries still in place */
+static unsigned canary_count(const uint16_t *buf)
+{
+    unsigned n = 0;
+
+    for (unsigned row = 0; row < IMAGE_HEIGHT; row = canary_next_row(row)) {
+        for (unsigned i = 0; i < NB_CANARY_COLUMNS; i++) {
+            n += IORD_16DIRECT(buf, 2 * (row * IMAGE_WIDTH + _canary_columns[i])) == CAMERA_CANARY_VALUE;
+        }
+    }
+    return n;
+}
+
+/* Fewest buffers for a queue mode: continuous mode needs a DMA target
+ * besides the frame held by the consumer, or no frame is ever delivered.
+ */
+static unsigned queue_min_frames(camera_queue_mode mode)
+{
+    return mode == CAMERA_QUEUE_CONTINUOUS ? 2 : 1;
+}
+
+/* Initialize the frame queue with n buffers of IMAGE_SIZE bytes.
+ * Returns false, leaving the queue unchanged, if n is below the minimum of
+ * the current mode (1, 2 in continuous mode).
+ * @note the first buffer becomes the frame buffer of the controller.
+ */
+bool camera_queue_init(uint16_t *const *bufs, unsigned n)
+{
+    if (n > CAMERA_QUEUE_MAX_FRAMES) {
+        n = CAMERA_QUEUE_MAX_FRAMES;
+    }
+    if (n < queue_min_frames(_queue.mode)) {
+        return false;
+    }
+    for (unsigned i = 0; i < n; i++) {
+        _queue.frames[i] = (camera_frame) { .buf = bufs[i] };
+        if (_queue.integrity == CAMERA_INTEGRITY_CANARY) {
+            canary_arm(bufs[i]);
+        }
+    }
+    _queue.n = n;
+    _queue.head = 0;
+    _queue.tail = 0;
+    _queue.held = false;
+    _queue.stalled = false;
+    _queue.received = 0;
+    _queue.dropped = 0;
+    _queue.dropped_since_last = 0;
+
+    camera_set_frame_buffer(_queue.frames[0].buf);
+    return true;
+}
+
+/* Select the queue behaviour when the consumer falls behind.
+ * Returns false, leaving the mode unchanged, if the queue was initialized
+ * with too few buffers for it.
+ * @note the default is CAMERA_QUEUE_BLOCKING.
+ */
+bool camera_queue_set_mode(camera_queue_mode mode)
+{
+    if (_queue.n != 0 && _queue.n < queue_min_frames(mode)) {
+        return false;
+    }
+    _queue.mode = mode;
+    return true;
+}
+
+/* Select the frame arrival check and arm all buffers for it.
+ * @note call with reception disabled, the default is CAMERA_INTEGRITY_OFF.
+ */
+void camera_queue_set_integrity(camera_integrity integrity)
+{
+    _queue.integrity = integrity;
+    if (integrity == CAMERA_INTEGRITY_CANARY) {
+        for (unsigned i = 0; i < _queue.n; i++) {
+            canary_arm(_queue.frames[i].buf);
+        }
+    }
+}
+
+/* Sensor registers copied into the frame metadata */
+static const uint8_t _exposure_regs[] = {
+    REG_SHUTTER_WIDTH_UPPER, REG_SHUTTER_WIDTH_LOWER, REG_GLOBAL_GAIN,
+    REG_GREEN1_GAIN, REG_BLUE_GAIN, REG_RED_GAIN, REG_GREEN2_GAIN,
+};
+
+#define NB_EXPOSURE_REGS (sizeof(_exposure_regs) / sizeof(_exposure_regs[0]))
+
+/* Fills in the metadata of a received frame.
+ * The exposure settings are only known while the shadow copy holds them,
+ * e.g. not after a failed shadow load in camera_setup() or camera_disable().
+ */
+static void frame_publish(camera_frame *frame, uint32_t seq, uint32_t timestamp)
+{
+    frame->seq = seq;
+    frame->timestamp = timestamp;
+    frame->exposure_known = true;
+    for (unsigned i = 0; i < NB_EXPOSURE_REGS; i++) {
+        frame->exposure_known &= shadow_is_valid(_exposure_regs[i]);
+    }
+    if (frame->exposure_known) {
+        frame->shutter_width = ((uint32_t) _shadow[REG_SHUTTER_WIDTH_UPPER] << 16) | _shadow[REG_SHUTTER_WIDTH_LOWER];
+        frame->global_gain = _shadow[REG_GLOBAL_GAIN];
+        frame->green1_gain = _shadow[REG_GREEN1_GAIN];
+        frame->blue_gain = _shadow[REG_BLUE_GAIN];
+        frame->red_gain = _shadow[REG_RED_GAIN];
+        frame->green2_gain = _shadow[REG_GREEN2_GAIN];
+    } else {
+        frame->shutter_width = 0;
+        frame->global_gain = 0;
+        frame->green1_gain = 0;
+        frame->blue_gain = 0;
+        frame->red_gain = 0;
+        frame->green2_gain = 0;
+    }
+    frame->dropped = _queue.dropped_since_last;
+    frame->canaries = _queue.integrity == CAMERA_INTEGRITY_CANARY ? canary_count(frame->buf) : 0;
+    frame->checksum = (frame_checksum) {0};
+    _queue.dropped_since_last = 0;
+}
+
+/* Continuous mode with no free buffer: publishes the received frame in
+ * place of the oldest waiting one, whose buffer becomes the DMA target.
+ * Returns false if no frame is waiting besides the held one.
+ */
+static bool queue_drop_oldest(uint32_t seq, uint32_t timestamp)
+{
+    unsigned n = _queue.n;
+    unsigned head = _queue.head;
+    unsigned oldest = _queue.tail + _queue.held;
+
+    if (oldest == head) {
+        return false;
+    }
+
+    frame_publish(&_queue.frames[head % n], seq, timestamp);
+
+    camera_frame dropped = _queue.frames[oldest % n];
+    for (unsigned i = oldest; i != head; i++) {
+        _queue.frames[i % n] = _queue.frames[(i + 1) % n];
+    }
+    /* the next frame accounts for the dropped one */
+    _queue.frames[oldest % n].dropped += dropped.dropped + 1;
+    _queue.frames[head % n] = (camera_frame) { .buf = dropped.buf };
+    _queue.dropped++;
+
+    if (_queue.integrity == CAMERA_INTEGRITY_CANARY) {
+        canary_arm(dropped.buf);
+    }
+    camera_set_frame_buffer(dropped.buf);
+    return true;
+}
+
+/* Frame complete handler, to be called from the camera interrupt.
+ * Publishes the received frame and moves the DMA target to the next free
+ * buffer while reception continues. Without a free buffer reception is
+ * stopped until camera_queue_release(), or in continuous mode the oldest
+ * waiting frame is dropped.
+ */
+void camera_queue_irq(void)
+{
+    uint32_t timestamp = _irq_timestamp;
+    uint32_t seq = _queue.received;
+    unsigned head = _queue.head + 1;
+
+    camera_clear_irq_flag();
+    if (_queue.n == 0) {
+        /* camera_queue_init() not called */
+        return;
+    }
+    _queue.received = seq + 1;
+
+    if (head - _queue.tail < _queue.n) {
+        camera_set_frame_buffer(_queue.frames[head % _queue.n].buf);
+    } else if (_queue.mode == CAMERA_QUEUE_CONTINUOUS) {
+        if (!queue_drop_oldest(seq, timestamp)) {
+            /* keep DMA target, next frame overwrites this one */
+            _queue.dropped++;
+            _queue.dropped_since_last++;
+        }
+        return;
+    } else {
+        /* restarted by camera_queue_release() */
+        camera_disable_receive();
+        _queue.stalled = true;
+    }
+
+    frame_publish(&_queue.frames[_queue.head % _queue.n], seq, timestamp);
+    _queue.head = head;
+}
+
+/* Returns the oldest received frame or NULL if the queue is empty.
+ * The frame stays valid until camera_queue_release() is called, only its
+ * checksum is meant to be written.
+ */
+camera_frame *camera_queue_get(void)
+{
+    /* held first: from then on the IRQ leaves frames[tail] alone */
+    _queue.held = true;
+
+    unsigned tail = _queue.tail;
+    if (tail == _queue.head) {
+        _queue.held = false;
+        return NULL;
+    }
+    return &_queue.frames[tail % _queue.n];
+}
+
+/* Hands the frame returned by camera_queue_get() back to the controller. */
+void camera_queue_release(void)
+{
+    unsigned tail = _queue.tail;
+
+    if (tail == _queue.head) {
+        return;
+    }
+    if (_queue.integrity == CAMERA_INTEGRITY_CANARY) {
+        canary_arm(_queue.frames[tail % _queue.n].buf);
+    }
+    /* tail before held: the IRQ must not see the released frame as waiting */
+    _queue.tail = tail + 1;
+    _queue.held = false;
+
+    if (_queue.stalled) {
+        _queue.stalled = false;
+        camera_set_frame_buffer(_queue.frames[_queue.head % _queue.n].buf);
+        camera_enable_receive();
+    }
+}
+
+/* Returns the number of received frames waiting in the queue. */
+unsigned camera_queue_count(void)
+{
+    return _queue.head - _queue.tail;
+}
+
+/* Returns the number of frames received by the controller since init. */
+uint32_t camera_queue_received(void)
+{
+    return _queue.received;
+}
+
+/* Returns the number of frames dropped in continuous mode since init. */
+uint32_t camera_queue_dropped(void)
+{
+    return _queue.dropped;
 }
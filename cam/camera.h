@@ -2,13 +2,45 @@
 #define CAMERA_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "i2c/i2c.h"
+#include "i2c/i2c_queue.h"
+#include "trdb_d5m_regs.h"
+#include "checksum.h"
 
 #define IMAGE_HEIGHT    240
 #define IMAGE_WIDTH     320
 #define IMAGE_SIZE 		(2*IMAGE_HEIGHT*IMAGE_WIDTH)
 
-void camera_setup(i2c_dev *i2c, uint16_t *buf, void (*isr)(void *), void *isr_arg);
+#define CAMERA_QUEUE_MAX_FRAMES 8
+
+/* Sensor configuration, see camera_apply_config() */
+typedef struct camera_config {
+    bool binning;               /* 4x bin and skip: 2560x1920 array to 640x480 */
+    bool mirror_row;
+    bool mirror_col;
+    uint8_t pixclk_div;         /* 0,1,2,4,8,16,32,64 half of effective divider */
+    bool test_pattern;
+    uint8_t test_pattern_type;  /* TEST_PATTERN_* */
+    uint16_t test_pattern_red;
+    uint16_t test_pattern_green;
+    uint16_t test_pattern_blue;
+    uint16_t test_pattern_bar_width;
+    uint32_t shutter_width;     /* in rows */
+    uint16_t vertical_blank;    /* in rows */
+} camera_config;
+
+extern const camera_config camera_config_default;
+
+/* Register write sequence entry, see camera_write_regs() */
+typedef struct camera_reg_write {
+    uint8_t reg;        /* REG_* */
+    uint16_t mask;      /* bits to modify, 0xffff writes the whole register */
+    uint16_t value;
+    uint16_t delay_us;  /* delay after the write */
+} camera_reg_write;
+
+int camera_setup(i2c_dev *i2c, uint16_t *buf, void (*isr)(void *), void *isr_arg);
 void camera_enable(void);
 void camera_disable(void);
 void camera_enable_receive(void);
@@ -19,6 +51,59 @@ bool camera_image_received(void);
 void camera_clear_irq_flag(void);
 void camera_set_frame_buffer(uint16_t *buf);
 uint16_t *camera_get_frame_buffer(void);
-void camera_dump_regs(void);
+int camera_read_regs(uint8_t first, unsigned count, uint16_t *data);
+int camera_dump_regs(void);
+unsigned camera_verify_regs(void);
+void camera_set_i2c_queue(i2c_queue *queue);
+bool camera_update_exposure(uint16_t shutter_width_lower, uint16_t global_gain);
+int camera_write_regs(const camera_reg_write *seq, unsigned n, unsigned *failed);
+int camera_apply_config(const camera_config *cfg, unsigned *writes);
+const camera_config *camera_get_config(void);
+
+/* Received frame with capture metadata */
+typedef struct camera_frame {
+    uint16_t *buf;
+    uint32_t seq;               /* frame sequence number, counts dropped frames */
+    uint32_t timestamp;         /* capture time, see camera_set_timestamp_source() */
+    bool exposure_known;        /* false if the sensor settings below were unknown, all 0 */
+    uint32_t shutter_width;     /* SHUTTER_WIDTH_UPPER << 16 | SHUTTER_WIDTH_LOWER */
+    uint16_t global_gain;
+    uint16_t green1_gain;
+    uint16_t blue_gain;
+    uint16_t red_gain;
+    uint16_t green2_gain;
+    uint32_t dropped;           /* frames dropped since the previous delivered frame */
+    uint16_t canaries;          /* canaries left unwritten, 0 for a complete frame */
+    frame_checksum checksum;    /* 0 until set by the consumer, e.g. from export_image() */
+} camera_frame;
+
+void camera_set_timestamp_source(uint32_t (*now)(void));
+void camera_stats_reset(void);
+void camera_stats_dump(void);
+
+/* Frame queue (single producer: camera IRQ, single consumer: main loop) */
+typedef enum {
+    CAMERA_QUEUE_BLOCKING,      /* stop reception while no buffer is free */
+    CAMERA_QUEUE_CONTINUOUS,    /* keep streaming, drop the oldest waiting frame while no buffer is free */
+} camera_queue_mode;
+
+/* Frame arrival check, see camera_queue_set_integrity() */
+typedef enum {
+    CAMERA_INTEGRITY_OFF,
+    CAMERA_INTEGRITY_CANARY,    /* sentinels in a sparse set of pixels, checked by the IRQ */
+} camera_integrity;
+
+#define CAMERA_CANARY_VALUE         0xdead
+#define CAMERA_CANARY_ROW_STRIDE    16
+
+bool camera_queue_init(uint16_t *const *bufs, unsigned n);
+bool camera_queue_set_mode(camera_queue_mode mode);
+void camera_queue_set_integrity(camera_integrity integrity);
+void camera_queue_irq(void);
+camera_frame *camera_queue_get(void);
+void camera_queue_release(void);
+unsigned camera_queue_count(void);
+uint32_t camera_queue_received(void);
+uint32_t camera_queue_dropped(void);
 
 #endif /* CAMERA_H */
@@ -0,0 +1,93 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "checksum.h"
+
+/* Frame checksums
+ *
+ * Detect frames corrupted on the way to the file (HPS bridge, hostfs). They
+ * are computed over the frame's little endian RGB565 bytes, so that they
+ * can be checked against the raw pixels whatever the export format:
+ *  - CRC-32: same value as zlib's crc32() or Python's binascii.crc32().
+ *  - MurmurHash3 x86_32 with seed 0: a multiply and a few shifts per 32-bit
+ *    word instead of four table lookups, for when CRC-32 is too slow.
+ * Both consume 32-bit words at once with checksum_add_pixels(), so they can
+ * be fused into a loop that already reads the pixels.
+ */
+
+#define CRC32_POLY  0xedb88320      /* reflected 0x04c11db7 */
+
+uint32_t checksum_crc32_table[256];
+static bool _crc32_table_ready;
+
+static void crc32_table_init(void)
+{
+    for (unsigned i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (unsigned bit = 0; bit < 8; bit++) {
+            c = (c & 1) ? (c >> 1) ^ CRC32_POLY : c >> 1;
+        }
+        checksum_crc32_table[i] = c;
+    }
+    _crc32_table_ready = true;
+}
+
+/* Starts the checksums given by kinds (CHECKSUM_*). */
+void checksum_init(checksum_state *st, unsigned kinds)
+{
+    if ((kinds & CHECKSUM_CRC32) && !_crc32_table_ready) {
+        crc32_table_init();
+    }
+    st->kinds = kinds;
+    st->crc = 0xffffffff;
+    st->hash = 0;
+    st->len = 0;
+    st->tail = 0;
+}
+
+/* Adds len bytes of data. */
+void checksum_update(checksum_state *st, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    for (size_t i = 0; i < len; i++) {
+        if (st->kinds & CHECKSUM_CRC32) {
+            st->crc = checksum_crc32_table[(st->crc ^ p[i]) & 0xff] ^ (st->crc >> 8);
+        }
+        if (st->kinds & CHECKSUM_MURMUR3) {
+            st->tail |= (uint32_t) p[i] << (8 * (st->len % 4));
+            if (st->len % 4 == 3) {
+                uint32_t h = st->hash ^ checksum_murmur3_mix(st->tail);
+                st->hash = checksum_rotl(h, 13) * 5 + 0xe6546b64;
+                st->tail = 0;
+            }
+        }
+        st->len++;
+    }
+}
+
+/* Stores the checksums of the bytes added so far, st can be updated further. */
+void checksum_final(const checksum_state *st, frame_checksum *sum)
+{
+    sum->crc32 = 0;
+    sum->murmur3 = 0;
+
+    if (st->kinds & CHECKSUM_CRC32) {
+        sum->crc32 = ~st->crc;
+    }
+    if (st->kinds & CHECKSUM_MURMUR3) {
+        uint32_t h = st->hash;
+
+        if (st->len % 4 != 0) {
+            h ^= checksum_murmur3_mix(st->tail);
+        }
+        h ^= st->len;
+        h ^= h >> 16;
+        h *= 0x85ebca6b;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35;
+        h ^= h >> 16;
+        sum->murmur3 = h;
+    }
+}
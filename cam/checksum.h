@@ -0,0 +1,64 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Checksums computed by a checksum_state, see checksum_init() */
+#define CHECKSUM_CRC32      0x1     /* CRC-32 (IEEE 802.3, as zlib), table driven */
+#define CHECKSUM_MURMUR3    0x2     /* MurmurHash3 x86_32, one multiply per byte pair */
+#define CHECKSUM_ALL        (CHECKSUM_CRC32 | CHECKSUM_MURMUR3)
+
+/* Frame checksums, 0 for the checksums not computed */
+typedef struct frame_checksum {
+    uint32_t crc32;
+    uint32_t murmur3;
+} frame_checksum;
+
+typedef struct checksum_state {
+    unsigned kinds;             /* CHECKSUM_* */
+    uint32_t crc;               /* inverted CRC-32 */
+    uint32_t hash;              /* MurmurHash3 state */
+    uint32_t len;               /* bytes hashed */
+    uint32_t tail;              /* bytes of an incomplete 32-bit word, little endian */
+} checksum_state;
+
+extern uint32_t checksum_crc32_table[256];
+
+void checksum_init(checksum_state *st, unsigned kinds);
+void checksum_update(checksum_state *st, const void *data, size_t len);
+void checksum_final(const checksum_state *st, frame_checksum *sum);
+
+static inline uint32_t checksum_rotl(uint32_t x, unsigned r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t checksum_murmur3_mix(uint32_t k)
+{
+    k *= 0xcc9e2d51;
+    k = checksum_rotl(k, 15);
+    return k * 0x1b873593;
+}
+
+/* Adds two RGB565 pixels, stored little endian (4 bytes).
+ * @note the bytes added so far must be a multiple of 4.
+ */
+static inline void checksum_add_pixels(checksum_state *st, uint16_t p0, uint16_t p1)
+{
+    if (st->kinds & CHECKSUM_CRC32) {
+        uint32_t crc = st->crc;
+        crc = checksum_crc32_table[(crc ^ p0) & 0xff] ^ (crc >> 8);
+        crc = checksum_crc32_table[(crc ^ (p0 >> 8)) & 0xff] ^ (crc >> 8);
+        crc = checksum_crc32_table[(crc ^ p1) & 0xff] ^ (crc >> 8);
+        crc = checksum_crc32_table[(crc ^ (p1 >> 8)) & 0xff] ^ (crc >> 8);
+        st->crc = crc;
+    }
+    if (st->kinds & CHECKSUM_MURMUR3) {
+        uint32_t h = st->hash ^ checksum_murmur3_mix((uint32_t) p1 << 16 | p0);
+        st->hash = checksum_rotl(h, 13) * 5 + 0xe6546b64;
+    }
+    st->len += 4;
+}
+
+#endif /* CHECKSUM_H */
@@ -0,0 +1,115 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <system.h>
+#include "cycles.h"
+
+/* Cycle counter
+ *
+ * Free-running 32-bit time base counting at cycles_freq() Hz, behind the
+ * frame timestamps, the ISR and I2C timing statistics and the benchmarks.
+ *
+ * Backends, in order of preference:
+ *  - Nios II: 32-bit free-running counter peripheral clocked by the CPU
+ *    clock, read at offset 0. Its base address is taken from CYCLE_COUNTER_BASE
+ *    (define it in the Makefile) or from CYCLE_COUNTER_0_BASE in system.h.
+ *  - Nios II: the HAL timestamp timer, if the BSP has one
+ *    (hal.timestamp_timer set to an Interval Timer in the Qsys system),
+ *    counting at alt_timestamp_freq().
+ *  - host: CLOCK_MONOTONIC, scaled to ALT_CPU_FREQ.
+ *
+ * The Qsys system of this project has neither peripheral yet: on the board
+ * cycles_init() fails, cycles_now() returns 0 and the features above are
+ * disabled (the build warns about it). Adding an Interval Timer and
+ * selecting it as timestamp timer in the BSP settings enables them without
+ * code change.
+ */
+#ifdef __nios2_arch__
+#include <io.h>
+
+#if !defined(CYCLE_COUNTER_BASE) && defined(CYCLE_COUNTER_0_BASE)
+#define CYCLE_COUNTER_BASE CYCLE_COUNTER_0_BASE
+#endif
+
+#if defined(CYCLE_COUNTER_BASE)
+
+bool cycles_init(void)
+{
+    return true;
+}
+
+uint32_t cycles_now(void)
+{
+    return IORD_32DIRECT(CYCLE_COUNTER_BASE, 0);
+}
+
+uint32_t cycles_freq(void)
+{
+    return ALT_CPU_FREQ;
+}
+
+#elif defined(ALT_TIMESTAMP_CLK_BASE)
+#include <sys/alt_timestamp.h>
+
+static uint32_t _freq;
+
+bool cycles_init(void)
+{
+    if (_freq == 0 && alt_timestamp_start() >= 0) {
+        _freq = alt_timestamp_freq();
+    }
+    return _freq != 0;
+}
+
+/* Truncated to 32 bits with a 64-bit timer, differences stay valid */
+uint32_t cycles_now(void)
+{
+    return _freq != 0 ? (uint32_t) alt_timestamp() : 0;
+}
+
+uint32_t cycles_freq(void)
+{
+    return _freq;
+}
+
+#else
+#warning "no cycle counter nor timestamp timer: frame timestamps, timing statistics and benchmarks disabled"
+
+bool cycles_init(void)
+{
+    return false;
+}
+
+uint32_t cycles_now(void)
+{
+    return 0;
+}
+
+uint32_t cycles_freq(void)
+{
+    return ALT_CPU_FREQ;
+}
+#endif
+
+#else
+#include <time.h>
+
+bool cycles_init(void)
+{
+    return true;
+}
+
+uint32_t cycles_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t) ((uint64_t) ts.tv_sec * ALT_CPU_FREQ +
+                       (uint64_t) ts.tv_nsec * ALT_CPU_FREQ / 1000000000);
+}
+
+uint32_t cycles_freq(void)
+{
+    return ALT_CPU_FREQ;
+}
+#endif
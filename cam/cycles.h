@@ -0,0 +1,11 @@
+#ifndef CYCLES_H
+#define CYCLES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+bool cycles_init(void);
+uint32_t cycles_now(void);
+uint32_t cycles_freq(void);
+
+#endif /* CYCLES_H */
@@ -0,0 +1,76 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <io.h>
+#include "camera.h"
+#include "downscale.h"
+
+/* Box filter downscaler for previews
+ *
+ * Each preview pixel is the rounded mean of a 2x2 or 4x4 block of the
+ * frame. The frame is read in a single streaming pass, two pixels per
+ * 32-bit uncached load, into one row of accumulators.
+ *
+ * The components are summed in packed form: a pixel spread over 32 bits as
+ * ---- -GGG GGG- ---- RRRR R--- ---B BBBB (SPREAD_MASK)
+ * leaves at least four free bits above each component, room for the sum of
+ * 16 pixels, so one addition accumulates all three components.
+ */
+
+#define SPREAD_MASK     0x07e0f81fu
+#define SPREAD_LSBS     0x00200801u     /* lowest bit of each component */
+
+static uint32_t _acc[IMAGE_WIDTH / 2];
+
+static inline uint32_t spread(uint32_t pixel)
+{
+    return (pixel | pixel << 16) & SPREAD_MASK;
+}
+
+static inline uint16_t pack(uint32_t spread)
+{
+    return (spread | spread >> 16) & 0xffff;
+}
+
+/* Writes the frame downscaled by 1 << shift (1 or 2) in both directions
+ * to dst, DOWNSCALE_SIZE(shift) bytes of memory. dst can be the frame
+ * itself: preview rows are written behind the frame rows already read.
+ * Returns false, leaving dst untouched, if shift is out of range.
+ */
+bool downscale(const uint16_t *image, unsigned shift, uint16_t *dst)
+{
+    if (shift == 0 || shift > DOWNSCALE_MAX_SHIFT) {
+        return false;
+    }
+
+    unsigned width = DOWNSCALE_WIDTH(shift);
+    unsigned block = 1u << shift;
+    unsigned words_per_col = block / 2;     /* input words per output pixel */
+    uint32_t round = (block * block / 2) * SPREAD_LSBS;
+    size_t off = 0;
+
+    for (unsigned y = 0; y < IMAGE_HEIGHT; y++) {
+        uint32_t *acc = _acc;
+
+        if (y % block == 0) {
+            for (unsigned i = 0; i < width; i++) {
+                _acc[i] = round;
+            }
+        }
+
+        for (unsigned i = 0; i < width; i++, acc++) {
+            for (unsigned k = 0; k < words_per_col; k++, off += 4) {
+                uint32_t w = IORD_32DIRECT(image, off);
+                *acc += spread(w & 0xffff) + spread(w >> 16);
+            }
+        }
+
+        if (y % block == block - 1) {
+            for (unsigned i = 0; i < width; i++) {
+                *dst++ = pack((_acc[i] >> (2 * shift)) & SPREAD_MASK);
+            }
+        }
+    }
+    return true;
+}
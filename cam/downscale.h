@@ -0,0 +1,17 @@
+#ifndef DOWNSCALE_H
+#define DOWNSCALE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "camera.h"
+
+/* Preview sizes, shift 1: 2x (160x120), shift 2: 4x (80x60) */
+#define DOWNSCALE_MAX_SHIFT         2
+#define DOWNSCALE_WIDTH(shift)      ((unsigned) IMAGE_WIDTH >> (shift))
+#define DOWNSCALE_HEIGHT(shift)     ((unsigned) IMAGE_HEIGHT >> (shift))
+#define DOWNSCALE_SIZE(shift)       (2 * DOWNSCALE_WIDTH(shift) * DOWNSCALE_HEIGHT(shift))
+
+bool downscale(const uint16_t *image, unsigned shift, uint16_t *dst);
+
+#endif /* DOWNSCALE_H */
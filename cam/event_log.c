@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "event_log.h"
+
+#if (EVENT_LOG_SIZE & (EVENT_LOG_SIZE - 1)) != 0
+#error "EVENT_LOG_SIZE must be a power of two"
+#endif
+
+/* Event ring
+ *
+ * Lock-free single producer / single consumer ring: records are pushed from
+ * one context only (the camera interrupt) and popped by the main loop. head
+ * is only written by the producer, after the record is complete, and tail
+ * only by the consumer, after the record is copied out, so neither side
+ * masks interrupts. When the ring is full new events are counted as lost.
+ */
+static struct {
+    event_record records[EVENT_LOG_SIZE];
+    volatile unsigned head;
+    volatile unsigned tail;
+    volatile uint32_t lost;
+} _log;
+
+static uint32_t (*_timestamp)(void);
+
+/* Set the function used to timestamp events, NULL disables timestamps. */
+void event_log_set_timestamp_source(uint32_t (*now)(void))
+{
+    _timestamp = now;
+}
+
+/* Keeps the compiler from moving record accesses across an index update.
+ * Single core: no hardware barrier needed. */
+#define COMPILER_BARRIER() __asm__ volatile ("" ::: "memory")
+
+/* Append an event to the log. Safe to call from interrupt context, the
+ * cost is a fixed number of stores independent of fmt.
+ * @note single producer: only call it from one context (the camera IRQ).
+ * Returns false if the ring is full and the event was lost.
+ */
+bool event_log_push(const char *fmt, uint32_t arg0, uint32_t arg1)
+{
+    unsigned head = _log.head;
+
+    if (head - _log.tail >= EVENT_LOG_SIZE) {
+        _log.lost++;
+        return false;
+    }
+
+    event_record *ev = &_log.records[head % EVENT_LOG_SIZE];
+    ev->fmt = fmt;
+    ev->arg0 = arg0;
+    ev->arg1 = arg1;
+    ev->timestamp = _timestamp != NULL ? _timestamp() : 0;
+    COMPILER_BARRIER();
+    _log.head = head + 1;
+    return true;
+}
+
+/* Remove the oldest event from the log.
+ * Returns false if the log is empty.
+ */
+bool event_log_pop(event_record *ev)
+{
+    unsigned tail = _log.tail;
+
+    if (tail == _log.head) {
+        return false;
+    }
+    COMPILER_BARRIER();
+    *ev = _log.records[tail % EVENT_LOG_SIZE];
+    COMPILER_BARRIER();
+    _log.tail = tail + 1;
+    return true;
+}
+
+/* Print all pending events, to be called from the main loop.
+ * Returns the number of printed events.
+ */
+unsigned event_log_drain(void)
+{
+    event_record ev;
+    unsigned n = 0;
+
+    while (event_log_pop(&ev)) {
+        printf("[%10lu] ", (unsigned long) ev.timestamp);
+        printf(ev.fmt, (unsigned long) ev.arg0, (unsigned long) ev.arg1);
+        n++;
+    }
+    return n;
+}
+
+/* Returns the number of events lost because the ring was full. */
+uint32_t event_log_lost(void)
+{
+    return _log.lost;
+}
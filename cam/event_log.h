@@ -0,0 +1,26 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Number of records in the ring, must be a power of two */
+#define EVENT_LOG_SIZE  32
+
+/* Event record, formatted later as printf(fmt, arg0, arg1).
+ * @note fmt must be a string literal and arguments are printed as unsigned long.
+ */
+typedef struct event_record {
+    const char *fmt;
+    uint32_t arg0;
+    uint32_t arg1;
+    uint32_t timestamp;
+} event_record;
+
+void event_log_set_timestamp_source(uint32_t (*now)(void));
+bool event_log_push(const char *fmt, uint32_t arg0, uint32_t arg1);
+bool event_log_pop(event_record *ev);
+unsigned event_log_drain(void);
+uint32_t event_log_lost(void);
+
+#endif /* EVENT_LOG_H */
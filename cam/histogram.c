@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "histogram.h"
+
+void histogram_reset(histogram *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = UINT32_MAX;
+}
+
+/* Add a sample, cheap enough for interrupt context. */
+void histogram_add(histogram *h, uint32_t value)
+{
+    unsigned bucket = value ? 32 - __builtin_clz(value) : 0;
+
+    h->count++;
+    h->sum += value;
+    if (value < h->min) {
+        h->min = value;
+    }
+    if (value > h->max) {
+        h->max = value;
+    }
+    h->buckets[bucket]++;
+}
+
+uint32_t histogram_mean(const histogram *h)
+{
+    if (h->count == 0) {
+        return 0;
+    }
+    return (uint32_t) (h->sum / h->count);
+}
+
+void histogram_print(const char *name, const histogram *h)
+{
+    if (h->count == 0) {
+        printf("%s: no samples\n", name);
+        return;
+    }
+
+    printf("%s: n=%lu min=%lu max=%lu mean=%lu\n",
+           name,
+           (unsigned long) h->count,
+           (unsigned long) h->min,
+           (unsigned long) h->max,
+           (unsigned long) histogram_mean(h));
+
+    for (unsigned i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (h->buckets[i] == 0) {
+            continue;
+        }
+        if (i == 0) {
+            printf("  %10u            : %lu\n", 0, (unsigned long) h->buckets[i]);
+        } else {
+            printf("  [%10lu, %10lu) : %lu\n",
+                   (unsigned long) (1ul << (i - 1)),
+                   i < 32 ? (unsigned long) (1ul << i) : (unsigned long) UINT32_MAX,
+                   (unsigned long) h->buckets[i]);
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+#define HISTOGRAM_BUCKETS   33
+
+/* Sample statistics with log2 buckets: bucket 0 counts zeros, bucket i
+ * counts values in [2^(i-1), 2^i).
+ */
+typedef struct histogram {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t buckets[HISTOGRAM_BUCKETS];
+} histogram;
+
+void histogram_reset(histogram *h);
+void histogram_add(histogram *h, uint32_t value);
+uint32_t histogram_mean(const histogram *h);
+void histogram_print(const char *name, const histogram *h);
+
+#endif /* HISTOGRAM_H */
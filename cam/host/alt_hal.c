@@ -0,0 +1,189 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "sys/alt_irq.h"
+#include "sys/alt_alarm.h"
+#include "host_io.h"
+
+/* HAL services emulated on the host
+ *
+ * Internal interrupt controller: one level sensitive line per irq number,
+ * a handler per line and a global enable. Handlers run from
+ * host_irq_service(), called by the bus after each device access, one at a
+ * time: a line raised by a handler is served after it returns.
+ *
+ * Devices running in their own thread raise their line with
+ * host_irq_assert_async(), which signals the thread running main() (the
+ * CPU) to serve it at once.
+ */
+
+#define HOST_IRQ_SIGNAL SIGUSR1
+
+static struct {
+    alt_isr_func isr;
+    void *context;
+    bool enabled;
+    volatile bool level;
+} _irq[HOST_IRQ_MAX];
+
+static volatile int _irq_enabled = 1;
+static volatile bool _irq_in_service;
+static volatile bool _irq_deferred;
+static pthread_t _cpu;
+
+volatile uint32_t _alt_nticks;
+uint32_t _alt_tick_rate;
+
+alt_irq_context alt_irq_disable_all(void)
+{
+    alt_irq_context context = _irq_enabled;
+
+    _irq_enabled = 0;
+    return context;
+}
+
+void alt_irq_enable_all(alt_irq_context context)
+{
+    _irq_enabled = context;
+    if (_irq_enabled) {
+        host_irq_service();
+    }
+}
+
+int alt_irq_enabled(void)
+{
+    return _irq_enabled;
+}
+
+int alt_ic_isr_register(alt_u32 ic_id, alt_u32 irq, alt_isr_func isr, void *isr_context, void *flags)
+{
+    (void) flags;
+
+    if (ic_id != 0 || irq >= HOST_IRQ_MAX) {
+        return -1;
+    }
+    _irq[irq].isr = isr;
+    _irq[irq].context = isr_context;
+    _irq[irq].enabled = isr != NULL;
+    host_irq_service();
+    return 0;
+}
+
+int alt_ic_irq_enable(alt_u32 ic_id, alt_u32 irq)
+{
+    if (ic_id != 0 || irq >= HOST_IRQ_MAX) {
+        return -1;
+    }
+    _irq[irq].enabled = true;
+    host_irq_service();
+    return 0;
+}
+
+int alt_ic_irq_disable(alt_u32 ic_id, alt_u32 irq)
+{
+    if (ic_id != 0 || irq >= HOST_IRQ_MAX) {
+        return -1;
+    }
+    _irq[irq].enabled = false;
+    return 0;
+}
+
+alt_u32 alt_ic_irq_enabled(alt_u32 ic_id, alt_u32 irq)
+{
+    if (ic_id != 0 || irq >= HOST_IRQ_MAX) {
+        return 0;
+    }
+    return _irq[irq].enabled;
+}
+
+void alt_tick(void)
+{
+    _alt_nticks++;
+}
+
+void host_irq_set(int irq, bool level)
+{
+    if (irq < 0 || irq >= HOST_IRQ_MAX) {
+        return;
+    }
+    _irq[irq].level = level;
+}
+
+/* Runs the handlers of the asserted and enabled lines, lowest number first
+ * like the Nios II internal interrupt controller. A line raised while
+ * handlers run is served before returning.
+ */
+void host_irq_service(void)
+{
+    if (_irq_in_service) {
+        _irq_deferred = true;
+        return;
+    }
+
+    do {
+        _irq_in_service = true;
+        _irq_deferred = false;
+
+        bool served;
+        do {
+            served = false;
+            for (unsigned i = 0; i < HOST_IRQ_MAX && _irq_enabled; i++) {
+                if (_irq[i].level && _irq[i].enabled && _irq[i].isr != NULL) {
+                    /* the CPU masks interrupts while in a handler */
+                    _irq_enabled = 0;
+                    _irq[i].isr(_irq[i].context);
+                    _irq_enabled = 1;
+                    served = true;
+                    break;
+                }
+            }
+        } while (served);
+
+        _irq_in_service = false;
+    } while (_irq_deferred);
+}
+
+/* Holds back interrupts during a device access, so that a handler never
+ * runs while a simulator is in the middle of one. Returns the previous state
+ * for host_irq_release().
+ */
+bool host_irq_hold(void)
+{
+    bool held = _irq_in_service;
+
+    _irq_in_service = true;
+    return held;
+}
+
+void host_irq_release(bool held)
+{
+    _irq_in_service = held;
+}
+
+static void irq_signal(int sig)
+{
+    (void) sig;
+    host_irq_service();
+}
+
+/* Makes the calling thread the CPU, the one running interrupt handlers */
+void host_irq_init(void)
+{
+    struct sigaction sa = {
+        .sa_handler = irq_signal,
+        .sa_flags = SA_RESTART,
+    };
+
+    _cpu = pthread_self();
+    sigemptyset(&sa.sa_mask);
+    sigaction(HOST_IRQ_SIGNAL, &sa, NULL);
+}
+
+void host_irq_assert_async(int irq)
+{
+    host_irq_set(irq, true);
+    pthread_kill(_cpu, HOST_IRQ_SIGNAL);
+}
@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include <system.h>
+#include "../i2c/i2c.h"
+#include "../i2c/i2c_queue.h"
+#include "../camera.h"
+#include "../bench.h"
+
+/* Runs the frame pipeline benchmarks of bench.c natively, with the sensor
+ * on the simulated bus. Frame benchmarks measure the host CPU, register
+ * sequences the driver overhead over the simulator. */
+
+#define I2C_FREQ (50000000)
+
+int main(void)
+{
+    i2c_dev i2c = i2c_inst((void *) I2C_0_BASE);
+    i2c_queue queue;
+    uint16_t *frame = (uint16_t *) HPS_0_BRIDGES_BASE;
+
+    i2c_init_speed(&i2c, I2C_FREQ, I2C_SPEED_FAST);
+    i2c_queue_init(&queue, &i2c);
+    camera_set_i2c_queue(&queue);
+
+    camera_set_frame_buffer(frame);
+    camera_disable_receive();
+    camera_disable();
+    camera_enable();
+    if (camera_setup(&i2c, frame, NULL, NULL) != I2C_SUCCESS) {
+        return 1;
+    }
+
+    return bench_run(frame, &i2c) > 0 ? 0 : 1;
+}
@@ -0,0 +1,49 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <system.h>
+#include "host_io.h"
+#include "board.h"
+
+/* Simulated system
+ *
+ * Stands in for the HAL's alt_sys_init(): instantiates the peripherals of
+ * system.h before main() runs.
+ *  - i2c_0 with the TRDB-D5M sensor on its bus
+ *  - cam_controller_0 fed by the sensor, its frame generator started
+ *  - the HPS bridge window as host memory
+ *
+ * Environment:
+ *  CAM_SIM_FRAME_US  frame period in microseconds, 0 for back to back
+ *                    frames (default 33333)
+ *  CAM_SIM_FRAMES    exit after that many frames, with a report on stderr
+ */
+
+/* Interrupt line of the camera controller, CAM_IRQ in camera.c */
+#define CAM_SIM_IRQ 1
+
+i2c_sim board_i2c;
+d5m_sim board_sensor;
+cam_sim board_camera;
+
+__attribute__((constructor))
+static void board_init(void)
+{
+    const char *env;
+
+    host_irq_init();
+    host_io_map_memory(HPS_0_BRIDGES_BASE, HPS_0_BRIDGES_SPAN);
+
+    i2c_sim_init(&board_i2c, I2C_0_BASE, I2C_0_IRQ);
+    d5m_sim_init(&board_sensor, &board_i2c);
+
+    cam_sim_init(&board_camera, CAM_CONTROLLER_0_BASE, CAM_SIM_IRQ, &board_sensor);
+    if ((env = getenv("CAM_SIM_FRAME_US")) != NULL) {
+        board_camera.frame_us = strtoul(env, NULL, 0);
+    }
+    if ((env = getenv("CAM_SIM_FRAMES")) != NULL) {
+        board_camera.max_frames = strtoul(env, NULL, 0);
+    }
+    cam_sim_start(&board_camera);
+}
@@ -0,0 +1,13 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include "i2c_sim.h"
+#include "d5m_sim.h"
+#include "cam_sim.h"
+
+/* Simulated DE1-SoC system, set up before main() */
+extern i2c_sim board_i2c;
+extern d5m_sim board_sensor;
+extern cam_sim board_camera;
+
+#endif /* BOARD_H */
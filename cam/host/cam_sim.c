@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <system.h>
+#include "host_io.h"
+#include "cam_sim.h"
+#include "../camera.h"
+
+/* Controller registers, see camera.c */
+#define CAM_CR  (0x00*4)
+#define CAM_IMR (0x01*4)
+#define CAM_ISR (0x02*4)
+#define CAM_IAR (0x03*4)
+
+#define CAM_CR_CON_EN_MASK  0x00000001
+#define CAM_CR_CAM_EN_MASK  0x00000002
+#define CAM_IMR_IRQ_MASK    0x00000001
+#define CAM_ISR_IRQ_MASK    0x00000001
+
+/* 12-bit sensor components to RGB565 */
+#define RGB565(r, g, b) ((uint16_t) ((((r) >> 7) << 11) | (((g) >> 6) << 5) | ((b) >> 7)))
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Called with the lock held */
+static void update_irq(cam_sim *cam)
+{
+    host_irq_set(cam->irq, (cam->isr & CAM_ISR_IRQ_MASK) && (cam->imr & CAM_IMR_IRQ_MASK));
+}
+
+static uint32_t cam_read(void *ctx, uint32_t offset, unsigned size)
+{
+    cam_sim *cam = ctx;
+    uint32_t value = 0;
+    (void) size;
+
+    pthread_mutex_lock(&cam->lock);
+    switch (offset) {
+    case CAM_CR:
+        value = cam->cr;
+        break;
+    case CAM_IMR:
+        value = cam->imr;
+        break;
+    case CAM_ISR:
+        value = cam->isr;
+        break;
+    case CAM_IAR:
+        value = cam->iar;
+        break;
+    }
+    pthread_mutex_unlock(&cam->lock);
+    return value;
+}
+
+static void cam_write(void *ctx, uint32_t offset, unsigned size, uint32_t value)
+{
+    cam_sim *cam = ctx;
+    (void) size;
+
+    pthread_mutex_lock(&cam->lock);
+    switch (offset) {
+    case CAM_CR:
+        if ((cam->cr & CAM_CR_CAM_EN_MASK) && !(value & CAM_CR_CAM_EN_MASK)) {
+            d5m_sim_reset(cam->sensor);
+        }
+        cam->cr = value;
+        break;
+    case CAM_IMR:
+        cam->imr = value;
+        update_irq(cam);
+        break;
+    case CAM_ISR:
+        /* write one to clear */
+        cam->isr &= ~value;
+        update_irq(cam);
+        break;
+    case CAM_IAR:
+        if (value != cam->iar && cam->stats.frames > 0) {
+            cam->stats.rotations++;
+        }
+        cam->iar = value;
+        break;
+    }
+    pthread_mutex_unlock(&cam->lock);
+}
+
+/* White, yellow, cyan, green, magenta, red, blue, black */
+static void color_bar(unsigned x, uint16_t *r, uint16_t *g, uint16_t *b)
+{
+    static const uint16_t bars[8][3] = {
+        {0xfff, 0xfff, 0xfff}, {0xfff, 0xfff, 0x000}, {0x000, 0xfff, 0xfff}, {0x000, 0xfff, 0x000},
+        {0xfff, 0x000, 0xfff}, {0xfff, 0x000, 0x000}, {0x000, 0x000, 0xfff}, {0x000, 0x000, 0x000},
+    };
+    unsigned bar = x * 8 / IMAGE_WIDTH;
+
+    *r = bars[bar][0], *g = bars[bar][1], *b = bars[bar][2];
+}
+
+/* Sensor rows or columns read per output pixel: a Bayer quad is 2 wide,
+ * bin and skip by (bin + 1) multiplies it (R0x22 / R0x23 [5:4]).
+ */
+static unsigned sensor_lines(const d5m_sim *sensor, uint8_t address_mode_reg, unsigned bin_pos)
+{
+    return 2 * (((d5m_sim_reg(sensor, address_mode_reg) >> bin_pos) & 3) + 1);
+}
+
+/* Test pattern colour of a pixel, as 12-bit components.
+ * Bars are test_pattern_bar_width + 1 sensor rows or columns wide. Same
+ * unverified model as test_pattern.c (gradients over output coordinates),
+ * written independently of it.
+ */
+static void test_pattern(const d5m_sim *sensor, unsigned type, unsigned x, unsigned y, uint32_t seq,
+                         uint16_t *r, uint16_t *g, uint16_t *b)
+{
+    uint16_t red = d5m_sim_reg(sensor, REG_TEST_PATTERN_RED) & 0xfff;
+    uint16_t green = d5m_sim_reg(sensor, REG_TEST_PATTERN_GREEN) & 0xfff;
+    uint16_t blue = d5m_sim_reg(sensor, REG_TEST_PATTERN_BLUE) & 0xfff;
+    unsigned width = d5m_sim_reg(sensor, REG_TEST_PATTERN_BAR_WIDTH) + 1;
+    unsigned row = y * sensor_lines(sensor, REG_ROW_ADDRESS_MODE, ROW_BIN_POS);
+    unsigned col = x * sensor_lines(sensor, REG_COLUMN_ADDRESS_MODE, COL_BIN_POS);
+    uint16_t v;
+
+    switch (type) {
+    case TEST_PATTERN_COLOR_FIELD:
+        *r = red, *g = green, *b = blue;
+        return;
+    case TEST_PATTERN_HORIZONTAL_GRADIENT:
+        v = x * 0xfff / (IMAGE_WIDTH - 1);
+        break;
+    case TEST_PATTERN_VERTICAL_GRADIENT:
+        v = y * 0xfff / (IMAGE_HEIGHT - 1);
+        break;
+    case TEST_PATTERN_DIAGONAL:
+        v = (x + y) * 0xfff / (IMAGE_WIDTH + IMAGE_HEIGHT - 2);
+        break;
+    case TEST_PATTERN_MARCHING_1S:
+        v = 1 << ((x + y + seq) % 12);
+        break;
+    case TEST_PATTERN_MONOCHROME_HORIZONTAL_BARS:
+        if ((row / width) % 2 == 0) {
+            *r = red, *g = green, *b = blue;
+        } else {
+            *r = *g = *b = 0;
+        }
+        return;
+    case TEST_PATTERN_MONOCHROME_VERTICAL_BARS:
+        if ((col / width) % 2 == 0) {
+            *r = red, *g = green, *b = blue;
+        } else {
+            *r = *g = *b = 0;
+        }
+        return;
+    case TEST_PATTERN_CLASSIC:
+        /* colour bars over a horizontal gradient */
+        if (y >= IMAGE_HEIGHT / 2) {
+            v = x * 0xfff / (IMAGE_WIDTH - 1);
+            break;
+        }
+        color_bar(x, r, g, b);
+        return;
+    case TEST_PATTERN_VERTICAL_COLOR_BARS:
+    default:
+        color_bar(x, r, g, b);
+        return;
+    }
+    *r = *g = *b = v;
+}
+
+/* Writes the frame the sensor currently outputs */
+void cam_sim_generate(const d5m_sim *sensor, uint16_t *buf, uint32_t seq)
+{
+    uint16_t control = d5m_sim_reg(sensor, REG_TEST_PATTERN_CONTROL);
+    uint16_t read_mode_2 = d5m_sim_reg(sensor, REG_READ_MODE_2);
+    bool pattern = control & ENABLE_TEST_PATTERN_MASK;
+    unsigned type = control >> TEST_PATTERN_CONTROL_POS;
+
+    for (unsigned y = 0; y < IMAGE_HEIGHT; y++) {
+        unsigned sy = (read_mode_2 & MIRROR_ROW_MASK) ? IMAGE_HEIGHT - 1 - y : y;
+
+        for (unsigned x = 0; x < IMAGE_WIDTH; x++) {
+            unsigned sx = (read_mode_2 & MIRROR_COL_MASK) ? IMAGE_WIDTH - 1 - x : x;
+            uint16_t pixel;
+
+            if (pattern) {
+                uint16_t r, g, b;
+
+                test_pattern(sensor, type, sx, sy, seq, &r, &g, &b);
+                pixel = RGB565(r, g, b);
+            } else {
+                pixel = (((sx + seq) & 0x1f) << 11) | (((sy + seq) & 0x3f) << 5) | (((sx + sy) >> 4) & 0x1f);
+            }
+            buf[y * IMAGE_WIDTH + x] = pixel;
+        }
+    }
+}
+
+static bool receiving(cam_sim *cam, uint32_t *iar)
+{
+    uint32_t enable = CAM_CR_CON_EN_MASK | CAM_CR_CAM_EN_MASK;
+    bool on;
+
+    pthread_mutex_lock(&cam->lock);
+    on = (cam->cr & enable) == enable &&
+         (d5m_sim_reg(cam->sensor, REG_OUTPUT_CONTROL) & CHIP_ENABLE_MASK);
+    *iar = cam->iar;
+    pthread_mutex_unlock(&cam->lock);
+    return on;
+}
+
+static void *generator(void *arg)
+{
+    cam_sim *cam = arg;
+    uint32_t seq = 0;
+    uint32_t iar;
+
+    for (;;) {
+        if (cam->frame_us > 0) {
+            usleep(cam->frame_us);
+        } else {
+            sched_yield();
+        }
+        if (!receiving(cam, &iar)) {
+            continue;
+        }
+        if (iar - HPS_0_BRIDGES_BASE > HPS_0_BRIDGES_SPAN - IMAGE_SIZE) {
+            fprintf(stderr, "cam_sim: frame buffer %#lx outside of the HPS bridge window\n",
+                    (unsigned long) iar);
+            continue;
+        }
+        if (cam->stats.frames == 0) {
+            cam->start_ns = now_ns();
+        }
+
+        cam_sim_generate(cam->sensor, (uint16_t *) (uintptr_t) iar, seq++);
+
+        pthread_mutex_lock(&cam->lock);
+        cam->stats.frames++;
+        if (cam->isr & CAM_ISR_IRQ_MASK) {
+            cam->stats.overruns++;
+        }
+        cam->isr |= CAM_ISR_IRQ_MASK;
+        if (cam->imr & CAM_IMR_IRQ_MASK) {
+            cam->stats.irqs++;
+        }
+        pthread_mutex_unlock(&cam->lock);
+        host_irq_assert_async(cam->irq);
+
+        if (cam->max_frames != 0 && cam->stats.frames == cam->max_frames) {
+            cam_sim_report(cam);
+            fflush(stdout);
+            _exit(0);
+        }
+    }
+    return NULL;
+}
+
+void cam_sim_init(cam_sim *cam, uintptr_t base, int irq, d5m_sim *sensor)
+{
+    *cam = (cam_sim) {
+        .irq = irq,
+        .sensor = sensor,
+        .frame_us = 33333,
+    };
+    pthread_mutex_init(&cam->lock, NULL);
+
+    host_io_register(&(host_io_device) {
+        .name = "cam_controller",
+        .base = base,
+        .span = 16,
+        .read = cam_read,
+        .write = cam_write,
+        .ctx = cam,
+    });
+}
+
+/* Starts the generator thread */
+void cam_sim_start(cam_sim *cam)
+{
+    if (pthread_create(&cam->thread, NULL, generator, cam) != 0) {
+        fprintf(stderr, "cam_sim: cannot start the frame generator\n");
+        abort();
+    }
+}
+
+/* Prints the frame statistics to stderr, rates since the first frame.
+ * Rotations are CAM_IAR changes: frames the driver queued and moved the
+ * DMA on from, not frames the application has handled (dropped frames
+ * keep the buffer).
+ */
+void cam_sim_report(const cam_sim *cam)
+{
+    double s = (now_ns() - cam->start_ns) / 1e9;
+
+    fprintf(stderr, "cam_sim: %lu frames, %lu irqs, %lu overruns, %lu buffer rotations in %.3f s\n",
+            cam->stats.frames, cam->stats.irqs, cam->stats.overruns, cam->stats.rotations, s);
+    if (s > 0) {
+        fprintf(stderr, "cam_sim: %.1f frames/s generated, %.1f buffer rotations/s\n",
+                cam->stats.frames / s, cam->stats.rotations / s);
+    }
+}
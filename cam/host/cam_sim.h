@@ -0,0 +1,52 @@
+#ifndef CAM_SIM_H
+#define CAM_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "d5m_sim.h"
+
+typedef struct cam_sim_stats {
+    unsigned long frames;       /* frames written to memory */
+    unsigned long irqs;         /* frame interrupts raised */
+    unsigned long overruns;     /* frames ending with the previous one still flagged */
+    unsigned long rotations;    /* frame buffer address changes, i.e. frames queued by the driver */
+} cam_sim_stats;
+
+/* Simulated camera controller (CAM_CR, CAM_IMR, CAM_ISR and CAM_IAR of
+ * camera.c) with the sensor's pixel output.
+ *
+ * A generator thread writes one RGB565 frame every frame_us microseconds
+ * (0: back to back) to the address in CAM_IAR while receive, camera and
+ * sensor chip are enabled. It then sets the interrupt flag and raises irq,
+ * delivered to the main thread as a signal, like a DMA engine that runs
+ * concurrently with the CPU. Clearing CAM_CR_CAM_EN resets the sensor.
+ *
+ * The image is the sensor's test pattern when enabled, modelled from the
+ * sensor registers independently of test_pattern.c, otherwise a gradient
+ * moving with the frame number.
+ */
+typedef struct cam_sim {
+    int irq;
+    d5m_sim *sensor;
+    unsigned frame_us;
+    unsigned long max_frames;   /* stop the program after that many frames, 0: never */
+
+    pthread_mutex_t lock;
+    uint32_t cr;
+    uint32_t imr;
+    uint32_t isr;
+    uint32_t iar;
+
+    pthread_t thread;
+    uint64_t start_ns;
+    cam_sim_stats stats;
+} cam_sim;
+
+void cam_sim_init(cam_sim *cam, uintptr_t base, int irq, d5m_sim *sensor);
+void cam_sim_start(cam_sim *cam);
+void cam_sim_generate(const d5m_sim *sensor, uint16_t *buf, uint32_t seq);
+void cam_sim_report(const cam_sim *cam);
+
+#endif /* CAM_SIM_H */
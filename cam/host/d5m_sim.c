@@ -0,0 +1,162 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "d5m_sim.h"
+#include "../trdb_d5m_regs.h"
+
+#define REG_DEFAULT(r, v) {(r), (v)}
+
+/* Power-on values, see the register map in trdb_d5m_regs.h */
+static const struct {
+    uint8_t reg;
+    uint16_t value;
+} _defaults[] = {
+    REG_DEFAULT(REG_CHIP_VERSION,             0x1801),
+    REG_DEFAULT(REG_ROW_START,                0x0036),
+    REG_DEFAULT(REG_COLUMN_STAR,              0x0010),
+    REG_DEFAULT(REG_ROW_SIZE,                 0x0797),
+    REG_DEFAULT(REG_COLUMN_SIZE,              0x0A1F),
+    REG_DEFAULT(REG_HORIZONTAL_BLANK,         0x0000),
+    REG_DEFAULT(REG_VERTICAL_BLANK,           0x0019),
+    REG_DEFAULT(REG_OUTPUT_CONTROL,           0x1F82),
+    REG_DEFAULT(REG_SHUTTER_WIDTH_UPPER,      0x0000),
+    REG_DEFAULT(REG_SHUTTER_WIDTH_LOWER,      0x0797),
+    REG_DEFAULT(REG_PIXEL_CLOCK_CONTROL,      0x0000),
+    REG_DEFAULT(REG_RESTART,                  0x0000),
+    REG_DEFAULT(REG_SHUTTER_DELAY,            0x0000),
+    REG_DEFAULT(REG_RESET,                    0x0000),
+    REG_DEFAULT(REG_PLL_CONTROL,              0x0050),
+    REG_DEFAULT(REG_PLL_CONFIG_1,             0x6404),
+    REG_DEFAULT(REG_PLL_CONFIG_2,             0x0000),
+    REG_DEFAULT(REG_READ_MODE_1,              0x4006),
+    REG_DEFAULT(REG_READ_MODE_2,              0x0007),
+    REG_DEFAULT(REG_ROW_ADDRESS_MODE,         0x8000),
+    REG_DEFAULT(REG_COLUMN_ADDRESS_MODE,      0x0007),
+    REG_DEFAULT(REG_GREEN1_GAIN,              0x0007),
+    REG_DEFAULT(REG_BLUE_GAIN,                0x0004),
+    REG_DEFAULT(REG_RED_GAIN,                 0x0001),
+    REG_DEFAULT(REG_GREEN2_GAIN,              0x005A),
+    REG_DEFAULT(REG_GLOBAL_GAIN,              0x231D),
+    REG_DEFAULT(REG_ROW_BLACK_TARGET,         0xA700),
+    REG_DEFAULT(REG_ROW_BLACK_DEFAULT_OFFSET, 0x0C00),
+    REG_DEFAULT(REG_TEST_PATTERN_CONTROL,     0x0000),
+    REG_DEFAULT(REG_TEST_PATTERN_GREEN,       0x0000),
+    REG_DEFAULT(REG_TEST_PATTERN_RED,         0x0000),
+    REG_DEFAULT(REG_TEST_PATTERN_BLUE,        0x0000),
+    REG_DEFAULT(REG_TEST_PATTERN_BAR_WIDTH,   0x0000),
+    REG_DEFAULT(REG_CHIP_VERSION_ALT,         0x1801),
+};
+
+#define NB_DEFAULTS (sizeof(_defaults) / sizeof(_defaults[0]))
+
+static void load_defaults(d5m_sim *sensor)
+{
+    memset(sensor->regs, 0, sizeof(sensor->regs));
+    for (unsigned i = 0; i < NB_DEFAULTS; i++) {
+        sensor->regs[_defaults[i].reg] = _defaults[i].value;
+    }
+}
+
+static void write_reg(d5m_sim *sensor, uint8_t reg, uint16_t value)
+{
+    sensor->stats.reg_writes++;
+
+    switch (reg) {
+    case REG_CHIP_VERSION:
+    case REG_CHIP_VERSION_ALT:
+        /* read-only */
+        break;
+    case REG_RESTART:
+        /* restart bit is self-clearing */
+        if (value & 0x0001) {
+            sensor->stats.restarts++;
+        }
+        sensor->regs[reg] = value & ~0x0001;
+        break;
+    case REG_RESET:
+        /* registers are held at their defaults while reset is set */
+        if (value & 0x0001) {
+            sensor->stats.resets++;
+            load_defaults(sensor);
+        }
+        sensor->regs[reg] = value;
+        break;
+    default:
+        if (!(sensor->regs[REG_RESET] & 0x0001)) {
+            sensor->regs[reg] = value;
+        }
+        break;
+    }
+}
+
+static void sensor_start(void *ctx, bool read)
+{
+    d5m_sim *sensor = ctx;
+
+    sensor->byte = 0;
+    /* a repeated start in read mode keeps the index just written */
+    (void) read;
+}
+
+static bool sensor_write(void *ctx, uint8_t data)
+{
+    d5m_sim *sensor = ctx;
+    unsigned n = sensor->byte++;
+
+    if (n == 0) {
+        sensor->index = data;
+    } else if (n % 2 == 1) {
+        sensor->msb = data;
+    } else {
+        write_reg(sensor, sensor->index++, ((uint16_t) sensor->msb << 8) | data);
+    }
+    return true;
+}
+
+static uint8_t sensor_read(void *ctx, bool ack)
+{
+    d5m_sim *sensor = ctx;
+    uint16_t value = sensor->regs[sensor->index];
+    (void) ack;
+
+    if (sensor->byte++ % 2 == 0) {
+        return value >> 8;
+    }
+    sensor->stats.reg_reads++;
+    sensor->index++;
+    return value & 0xff;
+}
+
+void d5m_sim_init(d5m_sim *sensor, i2c_sim *bus)
+{
+    *sensor = (d5m_sim) {
+        .slave = {
+            .address = TRDB_D5M_I2C_ADDRESS,
+            .start = sensor_start,
+            .write = sensor_write,
+            .read = sensor_read,
+            .ctx = sensor,
+        },
+    };
+    load_defaults(sensor);
+    i2c_sim_attach(bus, &sensor->slave);
+}
+
+/* Power cycle */
+void d5m_sim_reset(d5m_sim *sensor)
+{
+    load_defaults(sensor);
+    sensor->index = 0;
+    sensor->byte = 0;
+}
+
+uint16_t d5m_sim_reg(const d5m_sim *sensor, uint8_t reg)
+{
+    return sensor->regs[reg];
+}
+
+void d5m_sim_reset_stats(d5m_sim *sensor)
+{
+    sensor->stats = (d5m_sim_stats) {0};
+}
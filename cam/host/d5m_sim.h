@@ -0,0 +1,36 @@
+#ifndef D5M_SIM_H
+#define D5M_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "i2c_sim.h"
+
+typedef struct d5m_sim_stats {
+    unsigned long reg_reads;
+    unsigned long reg_writes;
+    unsigned long restarts;
+    unsigned long resets;
+} d5m_sim_stats;
+
+/* Simulated TRDB-D5M sensor register file behind TRDB_D5M_I2C_ADDRESS.
+ *
+ * Registers are 16 bits, transferred MSB first after an 8-bit index, with
+ * the index incremented after each register (burst reads and writes).
+ * Reset values are the documented defaults of trdb_d5m_regs.h.
+ */
+typedef struct d5m_sim {
+    i2c_sim_slave slave;
+    uint16_t regs[256];
+    uint8_t index;
+    unsigned byte;          /* bytes transferred since the start condition */
+    uint8_t msb;
+    d5m_sim_stats stats;
+} d5m_sim;
+
+void d5m_sim_init(d5m_sim *sensor, i2c_sim *bus);
+void d5m_sim_reset(d5m_sim *sensor);
+uint16_t d5m_sim_reg(const d5m_sim *sensor, uint8_t reg);
+void d5m_sim_reset_stats(d5m_sim *sensor);
+
+#endif /* D5M_SIM_H */
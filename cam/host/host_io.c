@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/mman.h>
+
+#include "host_io.h"
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+static host_io_device _devices[HOST_IO_MAX_DEVICES];
+static unsigned _nb_devices;
+static unsigned long _accesses;
+
+void host_io_register(const host_io_device *dev)
+{
+    if (_nb_devices == HOST_IO_MAX_DEVICES) {
+        fprintf(stderr, "host_io: too many devices, %s not registered\n", dev->name);
+        abort();
+    }
+    _devices[_nb_devices++] = *dev;
+}
+
+/* Maps zeroed memory at a fixed bus address, so that addresses taken from
+ * system.h can be dereferenced as on the target.
+ */
+void *host_io_map_memory(uintptr_t base, size_t span)
+{
+    void *mem = mmap((void *) base, span, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED_NOREPLACE, -1, 0);
+
+    if (mem == MAP_FAILED || mem != (void *) base) {
+        fprintf(stderr, "host_io: cannot map %#lx bytes at %#lx\n",
+                (unsigned long) span, (unsigned long) base);
+        abort();
+    }
+    return mem;
+}
+
+static host_io_device *find_device(uintptr_t addr)
+{
+    for (unsigned i = 0; i < _nb_devices; i++) {
+        if (addr - _devices[i].base < _devices[i].span) {
+            return &_devices[i];
+        }
+    }
+    fprintf(stderr, "host_io: no device at %#lx\n", (unsigned long) addr);
+    abort();
+}
+
+uint32_t host_io_read(uintptr_t addr, unsigned size)
+{
+    host_io_device *dev = find_device(addr);
+    bool held = host_irq_hold();
+    uint32_t value = dev->read(dev->ctx, addr - dev->base, size);
+
+    host_irq_release(held);
+    _accesses++;
+    host_irq_service();
+    return value;
+}
+
+void host_io_write(uintptr_t addr, unsigned size, uint32_t value)
+{
+    host_io_device *dev = find_device(addr);
+    bool held = host_irq_hold();
+
+    dev->write(dev->ctx, addr - dev->base, size, value);
+    host_irq_release(held);
+    _accesses++;
+    host_irq_service();
+}
+
+/* Number of device register accesses so far */
+unsigned long host_io_accesses(void)
+{
+    return _accesses;
+}
@@ -0,0 +1,48 @@
+#ifndef HOST_IO_H
+#define HOST_IO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Host bus emulation
+ *
+ * Peripheral registers live in the HOST_IO_DEVICE_BASE window of system.h
+ * and are dispatched to the simulator registered for the address. Any other
+ * address is host memory, accessed directly (e.g. the HPS bridge arena
+ * mapped by host_io_map_memory()).
+ */
+#define HOST_IO_DEVICE_BASE     0x10000000u
+#define HOST_IO_DEVICE_SPAN     0x00001000u
+#define HOST_IO_MAX_DEVICES     8
+
+/* Interrupt lines of the emulated internal interrupt controller */
+#define HOST_IRQ_MAX            32
+
+typedef struct host_io_device {
+    const char *name;
+    uintptr_t base;
+    uint32_t span;
+    uint32_t (*read)(void *ctx, uint32_t offset, unsigned size);
+    void (*write)(void *ctx, uint32_t offset, unsigned size, uint32_t value);
+    void *ctx;
+} host_io_device;
+
+void host_io_register(const host_io_device *dev);
+void *host_io_map_memory(uintptr_t base, size_t span);
+uint32_t host_io_read(uintptr_t addr, unsigned size);
+void host_io_write(uintptr_t addr, unsigned size, uint32_t value);
+unsigned long host_io_accesses(void);
+
+/* Level sensitive interrupt line, delivered to the handler registered with
+ * alt_ic_isr_register() at the next device access or when interrupts are
+ * enabled again.
+ */
+void host_irq_init(void);
+void host_irq_set(int irq, bool level);
+void host_irq_assert_async(int irq);
+void host_irq_service(void);
+bool host_irq_hold(void);
+void host_irq_release(bool held);
+
+#endif /* HOST_IO_H */
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "host_io.h"
+#include "i2c_sim.h"
+#include "../i2c/i2c_regs.h"
+
+#define I2C_SIM_BUSY_POLLS_DEFAULT 2
+
+static void set_irq(i2c_sim *sim, bool pending)
+{
+    if (pending) {
+        sim->status |= I2C_STATUS_INTERRUPT_PENDING_MSK;
+    } else {
+        sim->status &= ~I2C_STATUS_INTERRUPT_PENDING_MSK;
+    }
+    host_irq_set(sim->irq, pending);
+}
+
+static void set_nack(i2c_sim *sim, bool nack)
+{
+    if (nack) {
+        sim->status |= I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK;
+        sim->stats.nacks++;
+    } else {
+        sim->status &= ~I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK;
+    }
+}
+
+static void bus_stop(i2c_sim *sim)
+{
+    if (sim->selected != NULL && sim->selected->stop != NULL) {
+        sim->selected->stop(sim->selected->ctx);
+    }
+    sim->selected = NULL;
+    sim->status &= ~I2C_STATUS_BUS_BUSY_MSK;
+    sim->stats.stops++;
+}
+
+static void bus_start(i2c_sim *sim, uint8_t address)
+{
+    sim->stats.starts++;
+    sim->status |= I2C_STATUS_BUS_BUSY_MSK;
+    sim->selected = NULL;
+    sim->reading = address & 0x01;
+
+    for (unsigned i = 0; i < sim->nb_slaves; i++) {
+        if (sim->slaves[i]->address == (address & 0xfe)) {
+            sim->selected = sim->slaves[i];
+            break;
+        }
+    }
+    if (sim->selected != NULL && sim->selected->start != NULL) {
+        sim->selected->start(sim->selected->ctx, sim->reading);
+    }
+    set_nack(sim, sim->selected == NULL);
+}
+
+/* Executes the command written to the control register */
+static void command(i2c_sim *sim, uint8_t control)
+{
+    bool transfer = control & (I2C_CONTROL_WRITE_COMMAND_MSK | I2C_CONTROL_READ_COMMAND_MSK);
+
+    set_irq(sim, false);
+
+    if (sim->hung) {
+        /* only a stop sequence ends a hung transfer */
+        if (control & I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK) {
+            sim->hung = false;
+            sim->status &= ~I2C_STATUS_TRANSFER_IN_PROGRESS_MSK;
+            sim->stats.aborts++;
+            bus_stop(sim);
+        }
+        return;
+    }
+
+    if (transfer && sim->hang > 0) {
+        sim->hang--;
+        sim->hung = true;
+        sim->status |= I2C_STATUS_TRANSFER_IN_PROGRESS_MSK;
+        return;
+    }
+
+    if (control & I2C_CONTROL_WRITE_COMMAND_MSK) {
+        sim->stats.bytes_written++;
+        if (control & I2C_CONTROL_GENERATE_START_SEQUENCE_MSK) {
+            bus_start(sim, sim->data);
+        } else if (sim->selected != NULL && !sim->reading && sim->selected->write != NULL) {
+            set_nack(sim, !sim->selected->write(sim->selected->ctx, sim->data));
+        } else {
+            set_nack(sim, true);
+        }
+    } else if (control & I2C_CONTROL_READ_COMMAND_MSK) {
+        bool ack = !(control & I2C_CONTROL_ACKNOWLEDGE_READ_MSK);
+
+        sim->stats.bytes_read++;
+        if (sim->selected != NULL && sim->reading && sim->selected->read != NULL) {
+            sim->data = sim->selected->read(sim->selected->ctx, ack);
+        } else {
+            sim->data = 0xff;
+        }
+    }
+
+    if (control & I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK) {
+        bus_stop(sim);
+    }
+
+    if (transfer && (control & I2C_CONTROL_INTERRUPT_ENABLE_MSK)) {
+        set_irq(sim, true);
+    } else if ((transfer || (control & I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK)) && sim->busy_polls > 0) {
+        sim->remaining = sim->busy_polls;
+        sim->status |= I2C_STATUS_TRANSFER_IN_PROGRESS_MSK;
+    }
+}
+
+static uint32_t i2c_sim_read(void *ctx, uint32_t offset, unsigned size)
+{
+    i2c_sim *sim = ctx;
+    (void) size;
+
+    switch (offset) {
+    case I2C_DATA_OFST:
+        return sim->data;
+    case I2C_CONTROL_OFST:
+        return sim->control;
+    case I2C_STATUS_OFST: {
+        uint8_t status = sim->status;
+
+        sim->stats.status_reads++;
+        if (!sim->hung && sim->remaining > 0 && --sim->remaining == 0) {
+            sim->status &= ~I2C_STATUS_TRANSFER_IN_PROGRESS_MSK;
+        }
+        return status;
+    }
+    case I2C_CLOCK_DIVISOR_OFST:
+        return sim->divisor;
+    default:
+        return 0;
+    }
+}
+
+static void i2c_sim_write(void *ctx, uint32_t offset, unsigned size, uint32_t value)
+{
+    i2c_sim *sim = ctx;
+    (void) size;
+
+    switch (offset) {
+    case I2C_DATA_OFST:
+        sim->data = value;
+        break;
+    case I2C_CONTROL_OFST:
+        sim->control = value;
+        command(sim, value);
+        break;
+    case I2C_CLOCK_DIVISOR_OFST:
+        sim->divisor = value;
+        break;
+    default:
+        break;
+    }
+}
+
+void i2c_sim_init(i2c_sim *sim, uintptr_t base, int irq)
+{
+    *sim = (i2c_sim) {
+        .irq = irq,
+        .busy_polls = I2C_SIM_BUSY_POLLS_DEFAULT,
+    };
+
+    host_io_register(&(host_io_device) {
+        .name = "i2c",
+        .base = base,
+        .span = 4,
+        .read = i2c_sim_read,
+        .write = i2c_sim_write,
+        .ctx = sim,
+    });
+}
+
+void i2c_sim_attach(i2c_sim *sim, i2c_sim_slave *slave)
+{
+    if (sim->nb_slaves < I2C_SIM_MAX_SLAVES) {
+        sim->slaves[sim->nb_slaves++] = slave;
+    }
+}
+
+void i2c_sim_reset_stats(i2c_sim *sim)
+{
+    sim->stats = (i2c_sim_stats) {0};
+}
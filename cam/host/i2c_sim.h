@@ -0,0 +1,62 @@
+#ifndef I2C_SIM_H
+#define I2C_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define I2C_SIM_MAX_SLAVES 4
+
+/* Device on the simulated bus, addressed by its 8-bit write address */
+typedef struct i2c_sim_slave {
+    uint8_t address;
+    void (*start)(void *ctx, bool read);        /* addressed after a (repeated) start */
+    bool (*write)(void *ctx, uint8_t data);     /* returns the acknowledge */
+    uint8_t (*read)(void *ctx, bool ack);       /* ack: the master acknowledges the byte */
+    void (*stop)(void *ctx);
+    void *ctx;
+} i2c_sim_slave;
+
+typedef struct i2c_sim_stats {
+    unsigned long starts;           /* start and repeated start conditions */
+    unsigned long stops;
+    unsigned long bytes_written;    /* including address bytes */
+    unsigned long bytes_read;
+    unsigned long nacks;            /* bytes not acknowledged by a slave */
+    unsigned long status_reads;
+    unsigned long aborts;           /* stop sequences ending a hung transfer */
+} i2c_sim_stats;
+
+/* Simulated i2c controller (DATA, CONTROL, STATUS and CLOCK_DIVISOR
+ * registers of i2c_regs.h).
+ *
+ * A byte transfer takes effect when its command is written. Without the
+ * interrupt enabled, STATUS then reports it in progress for busy_polls
+ * reads, which exercises the driver's wait loops. With the interrupt enabled
+ * it ends at once and raises irq (if not negative). A lone stop sequence is
+ * in progress for busy_polls reads as well, without interrupt.
+ */
+typedef struct i2c_sim {
+    int irq;
+    unsigned busy_polls;
+    unsigned hang;                  /* fault injection: next byte transfers never end */
+
+    uint8_t data;
+    uint8_t control;
+    uint8_t status;
+    uint8_t divisor;
+    unsigned remaining;
+    bool hung;
+    bool reading;
+    i2c_sim_slave *selected;
+
+    i2c_sim_slave *slaves[I2C_SIM_MAX_SLAVES];
+    unsigned nb_slaves;
+
+    i2c_sim_stats stats;
+} i2c_sim;
+
+void i2c_sim_init(i2c_sim *sim, uintptr_t base, int irq);
+void i2c_sim_attach(i2c_sim *sim, i2c_sim_slave *slave);
+void i2c_sim_reset_stats(i2c_sim *sim);
+
+#endif /* I2C_SIM_H */
@@ -0,0 +1,75 @@
+#ifndef __IO_H__
+#define __IO_H__
+
+/* Host stand-in for the HAL's io.h
+ *
+ * Accesses in the peripheral window go to the simulated devices, all other
+ * addresses are plain (volatile) host memory, so frame buffer loops cost
+ * about what they cost with a real memory behind them.
+ */
+
+#include <stdint.h>
+
+#include "host_io.h"
+
+static inline int host_io_is_device(uintptr_t addr)
+{
+    return addr - HOST_IO_DEVICE_BASE < HOST_IO_DEVICE_SPAN;
+}
+
+static inline uint32_t host_io_rd32(uintptr_t addr)
+{
+    return host_io_is_device(addr) ? host_io_read(addr, 4) : *(volatile uint32_t *) addr;
+}
+
+static inline uint16_t host_io_rd16(uintptr_t addr)
+{
+    return host_io_is_device(addr) ? host_io_read(addr, 2) : *(volatile uint16_t *) addr;
+}
+
+static inline uint8_t host_io_rd8(uintptr_t addr)
+{
+    return host_io_is_device(addr) ? host_io_read(addr, 1) : *(volatile uint8_t *) addr;
+}
+
+static inline void host_io_wr32(uintptr_t addr, uint32_t data)
+{
+    if (host_io_is_device(addr)) {
+        host_io_write(addr, 4, data);
+    } else {
+        *(volatile uint32_t *) addr = data;
+    }
+}
+
+static inline void host_io_wr16(uintptr_t addr, uint16_t data)
+{
+    if (host_io_is_device(addr)) {
+        host_io_write(addr, 2, data);
+    } else {
+        *(volatile uint16_t *) addr = data;
+    }
+}
+
+static inline void host_io_wr8(uintptr_t addr, uint8_t data)
+{
+    if (host_io_is_device(addr)) {
+        host_io_write(addr, 1, data);
+    } else {
+        *(volatile uint8_t *) addr = data;
+    }
+}
+
+#define __IO_CALC_ADDRESS_DYNAMIC(BASE, OFFSET) ((uintptr_t) (BASE) + (OFFSET))
+
+#define IORD_32DIRECT(BASE, OFFSET)       host_io_rd32(__IO_CALC_ADDRESS_DYNAMIC((BASE), (OFFSET)))
+#define IORD_16DIRECT(BASE, OFFSET)       host_io_rd16(__IO_CALC_ADDRESS_DYNAMIC((BASE), (OFFSET)))
+#define IORD_8DIRECT(BASE, OFFSET)        host_io_rd8(__IO_CALC_ADDRESS_DYNAMIC((BASE), (OFFSET)))
+
+#define IOWR_32DIRECT(BASE, OFFSET, DATA) host_io_wr32(__IO_CALC_ADDRESS_DYNAMIC((BASE), (OFFSET)), (DATA))
+#define IOWR_16DIRECT(BASE, OFFSET, DATA) host_io_wr16(__IO_CALC_ADDRESS_DYNAMIC((BASE), (OFFSET)), (DATA))
+#define IOWR_8DIRECT(BASE, OFFSET, DATA)  host_io_wr8(__IO_CALC_ADDRESS_DYNAMIC((BASE), (OFFSET)), (DATA))
+
+#define IORD(BASE, REGNUM)                IORD_32DIRECT((BASE), (REGNUM) * 4)
+#define IOWR(BASE, REGNUM, DATA)          IOWR_32DIRECT((BASE), (REGNUM) * 4, (DATA))
+
+#endif /* __IO_H__ */
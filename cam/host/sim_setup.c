@@ -0,0 +1,688 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <system.h>
+#include "../i2c/i2c.h"
+#include "../i2c/i2c_queue.h"
+#include "../camera.h"
+#include "../test_pattern.h"
+#include "../downscale.h"
+#include "../rgb888.h"
+#include "../checksum.h"
+#include "../image_export.h"
+#include "board.h"
+
+/* Runs the camera setup against the simulated sensor and reports the I2C
+ * traffic of each step, one line per step:
+ *
+ *   step transactions errors timeouts starts bytes status_reads reg_reads reg_writes
+ *
+ * Exits with a non-zero status if a step fails, so it can run in CI.
+ */
+
+#define I2C_FREQ (50000000)
+
+static i2c_dev _i2c;
+static i2c_queue _queue;
+static unsigned _failures;
+
+static void step_begin(void)
+{
+    i2c_reset_stats(&_i2c);
+    i2c_sim_reset_stats(&board_i2c);
+    d5m_sim_reset_stats(&board_sensor);
+}
+
+static void step_end(const char *name, bool ok)
+{
+    printf("%-20s %6lu %3lu %3lu %6lu %7lu %8lu %5lu %5lu %s\n",
+           name,
+           (unsigned long) _i2c.stats.transactions,
+           (unsigned long) _i2c.stats.errors,
+           (unsigned long) _i2c.stats.timeouts,
+           board_i2c.stats.starts,
+           board_i2c.stats.bytes_written + board_i2c.stats.bytes_read,
+           board_i2c.stats.status_reads,
+           board_sensor.stats.reg_reads,
+           board_sensor.stats.reg_writes,
+           ok ? "ok" : "FAIL");
+    if (!ok) {
+        _failures++;
+    }
+}
+
+static void isr(void *arg)
+{
+    (void) arg;
+}
+
+/* Sensor registers must hold the applied configuration */
+static bool sensor_matches_config(void)
+{
+    const camera_config *cfg = camera_get_config();
+
+    return d5m_sim_reg(&board_sensor, REG_SHUTTER_WIDTH_LOWER) == (cfg->shutter_width & 0xffff) &&
+           d5m_sim_reg(&board_sensor, REG_VERTICAL_BLANK) == cfg->vertical_blank &&
+           d5m_sim_reg(&board_sensor, REG_TEST_PATTERN_BAR_WIDTH) == cfg->test_pattern_bar_width &&
+           (d5m_sim_reg(&board_sensor, REG_OUTPUT_CONTROL) & CHIP_ENABLE_MASK);
+}
+
+/* A transfer queued behind a failed one waits for the stop sequence ending
+ * the failure to leave the bus, without any poll (or interrupt) spinning on
+ * it, then completes.
+ */
+static bool deferred_start(void)
+{
+    const unsigned busy_polls = 50;
+    uint8_t byte = 0;
+    uint8_t version[2] = {0};
+    i2c_transfer absent = {
+        .device = 0x10,
+        .index = 0,
+        .data = &byte,
+        .size = 1,
+    };
+    i2c_transfer chip = {
+        .device = TRDB_D5M_I2C_ADDRESS,
+        .index = REG_CHIP_VERSION,
+        .read = true,
+        .data = version,
+        .size = 2,
+    };
+    unsigned saved_busy_polls = board_i2c.busy_polls;
+    unsigned long max_reads = 0;
+
+    board_i2c.busy_polls = busy_polls;
+    i2c_queue_submit(&_queue, &absent, I2C_QUEUE_PRIO_LOW);
+    i2c_queue_submit(&_queue, &chip, I2C_QUEUE_PRIO_LOW);
+    while (!i2c_queue_empty(&_queue)) {
+        unsigned long reads = board_i2c.stats.status_reads;
+
+        i2c_queue_poll(&_queue);
+        if (board_i2c.stats.status_reads - reads > max_reads) {
+            max_reads = board_i2c.stats.status_reads - reads;
+        }
+    }
+    board_i2c.busy_polls = saved_busy_polls;
+
+    return absent.status == I2C_ENODEV && chip.status == I2C_SUCCESS &&
+           version[0] == 0x18 && version[1] == 0x01 && max_reads < busy_polls;
+}
+
+static uint32_t _fake_time;
+
+static uint32_t fake_time(void)
+{
+    return _fake_time;
+}
+
+/* With a time source, a hung asynchronous transfer times out once the timeout
+ * duration has elapsed, not before, however often it is polled.
+ */
+static bool watchdog_time(void)
+{
+    uint8_t version[2];
+    i2c_transfer xfer = {
+        .device = TRDB_D5M_I2C_ADDRESS,
+        .index = REG_CHIP_VERSION,
+        .read = true,
+        .data = version,
+        .size = 2,
+    };
+    unsigned long polls;
+    uint32_t ticks;
+    bool early;
+    uint16_t value;
+
+    i2c_set_timestamp(&_i2c, fake_time, 1000000);
+    ticks = _i2c.timeout_ticks;
+    board_i2c.hang = 1;
+    i2c_queue_submit(&_queue, &xfer, I2C_QUEUE_PRIO_LOW);
+    for (polls = 0; polls < 2 * (unsigned long) _i2c.timeout_polls; polls++) {
+        i2c_queue_poll(&_queue);
+    }
+    _fake_time += ticks;
+    i2c_queue_poll(&_queue);
+    early = xfer.status != I2C_EBUSY;
+    _fake_time++;
+    i2c_queue_poll(&_queue);
+    i2c_set_timestamp(&_i2c, NULL, 0);
+
+    return ticks != 0 && !early && xfer.status == I2C_ETIMEOUT &&
+           camera_read_regs(REG_CHIP_VERSION, 1, &value) == I2C_SUCCESS && value == 0x1801;
+}
+
+/* A transfer timing out before i2c_init() leaves the clock divisor alone */
+static bool recover_uninit(void)
+{
+    i2c_dev dev = i2c_inst((void *) I2C_0_BASE);
+    uint8_t divisor = board_i2c.divisor;
+    uint8_t value;
+    int status;
+
+    board_i2c.hang = 1;
+    status = i2c_read(&dev, TRDB_D5M_I2C_ADDRESS, REG_CHIP_VERSION, &value);
+
+    return status == I2C_ETIMEOUT && divisor != 0 && board_i2c.divisor == divisor;
+}
+
+/* Every test pattern with binning and mirroring variants, generated by the
+ * simulator from the sensor registers, must match the expected frame of the
+ * applied configuration; a corrupted pixel must be reported.
+ */
+static bool test_patterns(uint16_t *frame)
+{
+    static const camera_config variants[] = {
+        {.binning = false},
+        {.binning = true},
+        {.mirror_row = true, .mirror_col = true},
+        {.binning = true, .mirror_col = true},
+    };
+    camera_config cfg = *camera_get_config();
+    test_pattern_result res;
+    uint32_t seq = 0;
+    bool ok = true;
+
+    cfg.test_pattern = true;
+    for (unsigned type = TEST_PATTERN_COLOR_FIELD; type <= TEST_PATTERN_VERTICAL_COLOR_BARS; type++) {
+        for (unsigned v = 0; v < sizeof(variants) / sizeof(variants[0]); v++) {
+            cfg.test_pattern_type = type;
+            cfg.binning = variants[v].binning;
+            cfg.mirror_row = variants[v].mirror_row;
+            cfg.mirror_col = variants[v].mirror_col;
+            if (camera_apply_config(&cfg, NULL) != I2C_SUCCESS) {
+                return false;
+            }
+            cam_sim_generate(&board_sensor, frame, seq++);
+            if (!test_pattern_verify(frame, camera_get_config(), &res)) {
+                printf("test pattern %u variant %u:\n", type, v);
+                test_pattern_print(&res);
+                ok = false;
+            }
+        }
+    }
+
+    frame[50 * IMAGE_WIDTH + 100] ^= 0x0800;
+    return ok && !test_pattern_verify(frame, camera_get_config(), &res) &&
+           res.mismatches == 1 && res.first == 50 * IMAGE_WIDTH + 100 &&
+           res.map[50 / TEST_PATTERN_TILE] == 1u << (100 / TEST_PATTERN_TILE);
+}
+
+/* Reference pixels of the test patterns, worked out by hand from the
+ * TRDB-D5M test pattern register descriptions rather than from either
+ * generator: red 0xfff, green and blue 0, bar width 15 (16 sensor columns,
+ * 8 output pixels, 2 with binning). They follow the same reading of the
+ * descriptions as the model (e.g. gradients over output coordinates) and
+ * are not taken from a real sensor: they check that both generators
+ * implement the model, not that the model is right.
+ */
+static const struct {
+    uint8_t type;
+    bool binning;
+    bool mirror_col;
+    uint8_t phase;              /* TEST_PATTERN_MARCHING_1S */
+    uint16_t x;
+    uint16_t y;
+    uint16_t pixel;
+} _pattern_refs[] = {
+    {TEST_PATTERN_COLOR_FIELD,                false, false, 0,   5,   5, 0xf800},
+    {TEST_PATTERN_HORIZONTAL_GRADIENT,        false, false, 0,   0,   0, 0x0000},
+    {TEST_PATTERN_HORIZONTAL_GRADIENT,        false, false, 0, 160,   0, 0x8410},
+    {TEST_PATTERN_HORIZONTAL_GRADIENT,        false, false, 0, 319,   0, 0xffff},
+    {TEST_PATTERN_VERTICAL_GRADIENT,          false, false, 0,   0, 120, 0x8410},
+    {TEST_PATTERN_VERTICAL_GRADIENT,          false, false, 0,   0, 239, 0xffff},
+    {TEST_PATTERN_DIAGONAL,                   false, false, 0,   0,   0, 0x0000},
+    {TEST_PATTERN_DIAGONAL,                   false, false, 0, 319, 239, 0xffff},
+    {TEST_PATTERN_CLASSIC,                    false, false, 0,   0,   0, 0xffff},
+    {TEST_PATTERN_CLASSIC,                    false, false, 0,  40,   0, 0xffe0},
+    {TEST_PATTERN_CLASSIC,                    false, false, 0,   0, 120, 0x0000},
+    {TEST_PATTERN_CLASSIC,                    false, false, 0, 319, 239, 0xffff},
+    {TEST_PATTERN_MARCHING_1S,                false, false, 0,   0,   0, 0x0000},
+    {TEST_PATTERN_MARCHING_1S,                false, false, 0,   7,   0, 0x0841},
+    {TEST_PATTERN_MARCHING_1S,                false, false, 0,  11,   0, 0x8410},
+    {TEST_PATTERN_MARCHING_1S,                false, false, 3,   8,   0, 0x8410},
+    {TEST_PATTERN_MONOCHROME_HORIZONTAL_BARS, false, false, 0,   0,   7, 0xf800},
+    {TEST_PATTERN_MONOCHROME_HORIZONTAL_BARS, false, false, 0,   0,   8, 0x0000},
+    {TEST_PATTERN_MONOCHROME_HORIZONTAL_BARS, true,  false, 0,   0,   2, 0x0000},
+    {TEST_PATTERN_MONOCHROME_VERTICAL_BARS,   false, false, 0,   7,   0, 0xf800},
+    {TEST_PATTERN_MONOCHROME_VERTICAL_BARS,   false, false, 0,   8,   0, 0x0000},
+    {TEST_PATTERN_MONOCHROME_VERTICAL_BARS,   false, false, 0,  16,   0, 0xf800},
+    {TEST_PATTERN_MONOCHROME_VERTICAL_BARS,   true,  false, 0,   1,   0, 0xf800},
+    {TEST_PATTERN_MONOCHROME_VERTICAL_BARS,   true,  false, 0,   2,   0, 0x0000},
+    {TEST_PATTERN_MONOCHROME_VERTICAL_BARS,   true,  true,  0, 318,   0, 0xf800},
+    {TEST_PATTERN_MONOCHROME_VERTICAL_BARS,   true,  true,  0, 317,   0, 0x0000},
+    {TEST_PATTERN_VERTICAL_COLOR_BARS,        false, false, 0,  80,   5, 0x07ff},
+    {TEST_PATTERN_VERTICAL_COLOR_BARS,        false, false, 0, 120,   5, 0x07e0},
+    {TEST_PATTERN_VERTICAL_COLOR_BARS,        false, false, 0, 200,   5, 0xf800},
+    {TEST_PATTERN_VERTICAL_COLOR_BARS,        false, false, 0, 280,   5, 0x0000},
+};
+
+#define NB_PATTERN_REFS (sizeof(_pattern_refs) / sizeof(_pattern_refs[0]))
+
+/* The simulator and the test pattern model must both produce the reference
+ * pixels.
+ */
+static bool pattern_refs(uint16_t *frame)
+{
+    camera_config cfg = *camera_get_config();
+    uint16_t row[IMAGE_WIDTH];
+    bool ok = true;
+
+    cfg.test_pattern = true;
+    cfg.test_pattern_red = 0xfff;
+    cfg.test_pattern_green = 0;
+    cfg.test_pattern_blue = 0;
+    cfg.test_pattern_bar_width = 15;
+    cfg.mirror_row = false;
+    for (unsigned i = 0; i < NB_PATTERN_REFS; i++) {
+        cfg.test_pattern_type = _pattern_refs[i].type;
+        cfg.binning = _pattern_refs[i].binning;
+        cfg.mirror_col = _pattern_refs[i].mirror_col;
+        if (camera_apply_config(&cfg, NULL) != I2C_SUCCESS) {
+            return false;
+        }
+        cam_sim_generate(&board_sensor, frame, _pattern_refs[i].phase);
+        test_pattern_row(&cfg, _pattern_refs[i].phase, _pattern_refs[i].y, row);
+
+        uint16_t sim = frame[_pattern_refs[i].y * IMAGE_WIDTH + _pattern_refs[i].x];
+        uint16_t model = row[_pattern_refs[i].x];
+        if (sim != _pattern_refs[i].pixel || model != _pattern_refs[i].pixel) {
+            printf("test pattern %u (%u, %u): simulator %04x, model %04x, reference %04x\n",
+                   _pattern_refs[i].type, _pattern_refs[i].x, _pattern_refs[i].y,
+                   sim, model, _pattern_refs[i].pixel);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/* Frame queue buffers, never written: the simulated controller is not
+ * receiving and the integrity check is off during frame_queue().
+ */
+static uint16_t _queue_bufs[3][2];
+
+/* Gets the next frame, which must be frame seq reporting dropped frames
+ * before it, in another buffer than the DMA target. Releases it unless
+ * hold is set.
+ */
+static bool queue_expect(uint32_t seq, uint32_t dropped, bool hold)
+{
+    camera_frame *frame = camera_queue_get();
+
+    if (frame == NULL) {
+        printf("frame queue: expected frame %lu, got none\n", (unsigned long) seq);
+        return false;
+    }
+    bool ok = frame->seq == seq && frame->dropped == dropped && frame->buf != camera_get_frame_buffer();
+    if (!ok) {
+        printf("frame queue: expected frame %lu (%lu dropped), got frame %lu (%lu dropped)%s\n",
+               (unsigned long) seq, (unsigned long) dropped,
+               (unsigned long) frame->seq, (unsigned long) frame->dropped,
+               frame->buf == camera_get_frame_buffer() ? " in the DMA target" : "");
+    }
+    if (!hold) {
+        camera_queue_release();
+    }
+    return ok;
+}
+
+static void queue_irqs(unsigned n)
+{
+    for (unsigned i = 0; i < n; i++) {
+        camera_queue_irq();
+    }
+}
+
+/* Initializes the queue with n buffers in the given mode */
+static bool queue_setup(unsigned n, camera_queue_mode mode)
+{
+    uint16_t *const bufs[3] = {_queue_bufs[0], _queue_bufs[1], _queue_bufs[2]};
+
+    return camera_queue_set_mode(CAMERA_QUEUE_BLOCKING) && camera_queue_init(bufs, n) &&
+           camera_queue_set_mode(mode);
+}
+
+/* Frame queue sequence numbers, dropped counts and buffer rotation with 1 to
+ * 3 buffers, in both modes, with and without a frame held by the consumer.
+ */
+static bool frame_queue(void)
+{
+    uint16_t *const bufs[3] = {_queue_bufs[0], _queue_bufs[1], _queue_bufs[2]};
+    bool ok = true;
+
+    camera_queue_set_integrity(CAMERA_INTEGRITY_OFF);
+
+    /* too few buffers */
+    ok = ok && camera_queue_set_mode(CAMERA_QUEUE_BLOCKING) && !camera_queue_init(bufs, 0);
+    ok = ok && camera_queue_set_mode(CAMERA_QUEUE_CONTINUOUS) && !camera_queue_init(bufs, 1);
+    ok = ok && queue_setup(1, CAMERA_QUEUE_BLOCKING) && !camera_queue_set_mode(CAMERA_QUEUE_CONTINUOUS);
+
+    /* blocking, 1 buffer: every frame stops reception until released */
+    ok = ok && queue_setup(1, CAMERA_QUEUE_BLOCKING);
+    queue_irqs(1);
+    ok = ok && camera_queue_count() == 1 && queue_expect(0, 0, false);
+    queue_irqs(1);
+    ok = ok && queue_expect(1, 0, false) && camera_queue_get() == NULL;
+
+    /* blocking, 3 buffers: all three filled, nothing dropped */
+    ok = ok && queue_setup(3, CAMERA_QUEUE_BLOCKING);
+    queue_irqs(3);
+    ok = ok && queue_expect(0, 0, false) && queue_expect(1, 0, false) && queue_expect(2, 0, false);
+    ok = ok && camera_queue_get() == NULL && camera_queue_dropped() == 0;
+
+    /* continuous, 2 buffers, not held: the newer frame replaces the older */
+    ok = ok && queue_setup(2, CAMERA_QUEUE_CONTINUOUS);
+    queue_irqs(2);
+    ok = ok && queue_expect(1, 1, false) && camera_queue_get() == NULL;
+
+    /* continuous, 2 buffers, held: nothing else waits, new frames are
+     * dropped into the DMA target */
+    ok = ok && queue_setup(2, CAMERA_QUEUE_CONTINUOUS);
+    queue_irqs(1);
+    ok = ok && queue_expect(0, 0, true);
+    queue_irqs(2);
+    camera_queue_release();
+    queue_irqs(1);
+    ok = ok && queue_expect(3, 2, false) && camera_queue_dropped() == 2;
+
+    /* continuous, 3 buffers: the oldest waiting frames are dropped, never
+     * the held one */
+    ok = ok && queue_setup(3, CAMERA_QUEUE_CONTINUOUS);
+    queue_irqs(5);
+    ok = ok && queue_expect(3, 3, true);
+    queue_irqs(2);
+    camera_queue_release();
+    ok = ok && queue_expect(6, 2, false) && camera_queue_get() == NULL;
+    ok = ok && camera_queue_received() == 7 && camera_queue_dropped() == 5;
+
+    /* the three buffers are all still in use */
+    queue_irqs(2);
+    camera_frame *first = camera_queue_get();
+    ok = ok && first != NULL;
+    if (ok) {
+        uint16_t *held = first->buf;
+        camera_queue_release();
+        camera_frame *second = camera_queue_get();
+        ok = second != NULL && second->buf != held && second->buf != camera_get_frame_buffer() &&
+             held != camera_get_frame_buffer();
+        camera_queue_release();
+    }
+    return ok;
+}
+
+/* Rounded mean of the block of 1 << shift pixels at preview pixel (x, y) */
+static uint16_t box_mean(const uint16_t *frame, unsigned shift, unsigned x, unsigned y)
+{
+    unsigned block = 1u << shift;
+    unsigned n = block * block;
+    unsigned r = 0, g = 0, b = 0;
+
+    for (unsigned j = 0; j < block; j++) {
+        for (unsigned i = 0; i < block; i++) {
+            uint16_t p = frame[(y * block + j) * IMAGE_WIDTH + x * block + i];
+            r += p >> 11;
+            g += (p >> 5) & 0x3f;
+            b += p & 0x1f;
+        }
+    }
+    return ((r + n / 2) / n) << 11 | ((g + n / 2) / n) << 5 | ((b + n / 2) / n);
+}
+
+/* Both preview sizes must match a per-component box filter, out of range
+ * shifts must be rejected without touching the preview buffer.
+ */
+static bool downscale_check(uint16_t *frame)
+{
+    static uint16_t preview[DOWNSCALE_SIZE(1) / 2];
+    uint32_t x = 1;
+    bool ok = true;
+
+    for (unsigned i = 0; i < IMAGE_SIZE / 2; i++) {
+        x = x * 1103515245 + 12345;
+        frame[i] = x >> 16;
+    }
+
+    for (unsigned shift = 1; shift <= DOWNSCALE_MAX_SHIFT; shift++) {
+        ok = ok && downscale(frame, shift, preview);
+        for (unsigned py = 0; ok && py < DOWNSCALE_HEIGHT(shift); py++) {
+            for (unsigned px = 0; ok && px < DOWNSCALE_WIDTH(shift); px++) {
+                ok = preview[py * DOWNSCALE_WIDTH(shift) + px] == box_mean(frame, shift, px, py);
+            }
+        }
+    }
+
+    preview[0] = 0x1234;
+    ok = ok && !downscale(frame, 0, preview) && !downscale(frame, DOWNSCALE_MAX_SHIFT + 1, preview);
+    return ok && preview[0] == 0x1234;
+}
+
+/* Reference conversion with shifts, bit replication written out per
+ * component */
+static uint32_t rgb888_shift(uint16_t pixel)
+{
+    uint32_t r5 = pixel >> 11;
+    uint32_t g6 = (pixel >> 5) & 0x3f;
+    uint32_t b5 = pixel & 0x1f;
+
+    return (r5 << 3 | r5 >> 2) << 16 | (g6 << 2 | g6 >> 4) << 8 | (b5 << 3 | b5 >> 2);
+}
+
+/* The lookup tables must match the shift conversion for all 65536 pixels,
+ * through rgb888_pixel() and rgb888_row(), and keep the top bits of the
+ * former conversion without bit replication.
+ */
+static bool rgb888_check(uint16_t *frame)
+{
+    static uint8_t row[3 * 65536];
+    bool ok = true;
+
+    for (unsigned p = 0; p < 65536; p++) {
+        frame[p] = p;
+    }
+    rgb888_row(frame, 65536, row, NULL);
+
+    for (unsigned p = 0; ok && p < 65536; p++) {
+        uint32_t rgb = rgb888_shift(p);
+        uint32_t former = (p >> 11) << 19 | ((p >> 5) & 0x3f) << 10 | (p & 0x1f) << 3;
+
+        ok = rgb888_pixel(p) == rgb && (rgb & 0xf8fcf8) == former &&
+             row[3 * p] == (uint8_t) (rgb >> 16) && row[3 * p + 1] == (uint8_t) (rgb >> 8) &&
+             row[3 * p + 2] == (uint8_t) rgb;
+    }
+    return ok;
+}
+
+/* Published CRC-32 (zlib) and MurmurHash3 x86_32 (seed 0) values, over the
+ * whole string and byte by byte, and the pixel path against the byte path.
+ */
+static bool checksum_check(void)
+{
+    static const struct {
+        const char *text;
+        uint32_t crc32;
+        uint32_t murmur3;
+    } vectors[] = {
+        {"", 0x00000000, 0x00000000},
+        {"hello", 0x3610a686, 0x248bfa47},
+        {"test", 0xd87f7e0c, 0xba6bd213},
+        {"123456789", 0xcbf43926, 0xb4fef382},
+        {"The quick brown fox jumps over the lazy dog", 0x414fa339, 0x2e4ff723},
+    };
+    static const uint16_t pixels[4] = {0x1234, 0xabcd, 0xf800, 0x07e0};
+    static const uint8_t bytes[8] = {0x34, 0x12, 0xcd, 0xab, 0x00, 0xf8, 0xe0, 0x07};
+    checksum_state st;
+    frame_checksum whole, split;
+    bool ok = true;
+
+    for (unsigned v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++) {
+        size_t len = strlen(vectors[v].text);
+
+        checksum_init(&st, CHECKSUM_ALL);
+        checksum_update(&st, vectors[v].text, len);
+        checksum_final(&st, &whole);
+
+        checksum_init(&st, CHECKSUM_ALL);
+        for (size_t i = 0; i < len; i++) {
+            checksum_update(&st, vectors[v].text + i, 1);
+        }
+        checksum_final(&st, &split);
+
+        ok = ok && whole.crc32 == vectors[v].crc32 && whole.murmur3 == vectors[v].murmur3 &&
+             split.crc32 == whole.crc32 && split.murmur3 == whole.murmur3;
+    }
+
+    checksum_init(&st, CHECKSUM_ALL);
+    checksum_update(&st, bytes, sizeof(bytes));
+    checksum_final(&st, &whole);
+    checksum_init(&st, CHECKSUM_ALL);
+    checksum_add_pixels(&st, pixels[0], pixels[1]);
+    checksum_add_pixels(&st, pixels[2], pixels[3]);
+    checksum_final(&st, &split);
+
+    return ok && split.crc32 == whole.crc32 && split.murmur3 == whole.murmur3;
+}
+
+/* A binary PPM export must read back with the header checksum comment
+ * patched in place, equal to the checksums of the frame's little endian
+ * RGB565 bytes, and the RGB888 pixels of the frame.
+ */
+static bool export_check(uint16_t *frame)
+{
+    static const char *filename = "sim_setup.ppm";
+    static uint8_t pixels[3 * IMAGE_WIDTH * IMAGE_HEIGHT];
+    frame_checksum sum, expected;
+    checksum_state st;
+    unsigned long crc32, murmur3;
+    unsigned width, height, maxval;
+    int header = 0;
+    uint32_t x = 1;
+    bool ok;
+
+    for (unsigned i = 0; i < IMAGE_SIZE / 2; i++) {
+        x = x * 1103515245 + 12345;
+        frame[i] = x >> 16;
+    }
+    checksum_init(&st, CHECKSUM_ALL);
+    checksum_update(&st, frame, IMAGE_SIZE);
+    checksum_final(&st, &expected);
+
+    if (!export_image(frame, filename, EXPORT_FORMAT_PPM_P6, NULL, &sum)) {
+        return false;
+    }
+
+    FILE *f = fopen(filename, "rb");
+    ok = f != NULL &&
+         fscanf(f, "P6\n# crc32 %8lx murmur3 %8lx\n%u %u\n%u%n",
+                &crc32, &murmur3, &width, &height, &maxval, &header) == 5 &&
+         header == 48 && fgetc(f) == '\n' && fread(pixels, 1, sizeof(pixels), f) == sizeof(pixels) && fgetc(f) == EOF;
+    if (f != NULL) {
+        fclose(f);
+    }
+    remove(filename);
+
+    ok = ok && width == IMAGE_WIDTH && height == IMAGE_HEIGHT && maxval == 255 &&
+         crc32 == expected.crc32 && murmur3 == expected.murmur3 &&
+         sum.crc32 == expected.crc32 && sum.murmur3 == expected.murmur3;
+    for (unsigned i = 0; ok && i < IMAGE_SIZE / 2; i++) {
+        uint32_t rgb = rgb888_shift(frame[i]);
+
+        ok = pixels[3 * i] == (uint8_t) (rgb >> 16) && pixels[3 * i + 1] == (uint8_t) (rgb >> 8) &&
+             pixels[3 * i + 2] == (uint8_t) rgb;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    uint16_t value;
+
+    _i2c = i2c_inst((void *) I2C_0_BASE);
+    i2c_init_speed(&_i2c, I2C_FREQ, I2C_SPEED_FAST);
+    i2c_queue_init(&_queue, &_i2c);
+    camera_set_i2c_queue(&_queue);
+
+    camera_set_frame_buffer((uint16_t *) HPS_0_BRIDGES_BASE);
+    camera_disable_receive();
+    camera_disable();
+    camera_enable();
+
+    printf("%-20s %6s %3s %3s %6s %7s %8s %5s %5s\n", "step",
+           "xfers", "err", "to", "starts", "bytes", "polls", "rd", "wr");
+
+    step_begin();
+    int status = camera_setup(&_i2c, (uint16_t *) HPS_0_BRIDGES_BASE, isr, NULL);
+    step_end("camera_setup", status == I2C_SUCCESS && _i2c.stats.errors == 0 && sensor_matches_config());
+
+    step_begin();
+    status = camera_dump_regs();
+    step_end("camera_dump_regs", status == I2C_SUCCESS && _i2c.stats.errors == 0);
+
+    step_begin();
+    step_end("camera_verify_regs", camera_verify_regs() == 0);
+
+    camera_config cfg = *camera_get_config();
+    cfg.shutter_width = 1000;
+    cfg.test_pattern = false;
+    step_begin();
+    unsigned writes;
+    status = camera_apply_config(&cfg, &writes);
+    step_end("camera_apply_config", status == I2C_SUCCESS && writes > 0 && sensor_matches_config());
+
+    step_begin();
+    bool queued = camera_update_exposure(500, 0x0020);
+    while (!i2c_queue_empty(&_queue) || i2c_busy(&_i2c)) {
+        i2c_queue_poll(&_queue);
+    }
+    step_end("camera_update_exp", queued &&
+             d5m_sim_reg(&board_sensor, REG_SHUTTER_WIDTH_LOWER) == 500 &&
+             d5m_sim_reg(&board_sensor, REG_GLOBAL_GAIN) == 0x0020 &&
+             sensor_matches_config());
+
+    /* the shutter width changed behind the configuration must be restored */
+    step_begin();
+    status = camera_apply_config(&cfg, &writes);
+    step_end("camera_reapply", status == I2C_SUCCESS && writes == 1 && sensor_matches_config() &&
+             d5m_sim_reg(&board_sensor, REG_SHUTTER_WIDTH_LOWER) == 1000);
+
+    /* a hung byte transfer times out, then the bus works again */
+    step_begin();
+    board_i2c.hang = 1;
+    bool timed_out = camera_read_regs(REG_CHIP_VERSION, 1, &value) == I2C_ETIMEOUT;
+    bool recovered = camera_read_regs(REG_CHIP_VERSION, 1, &value) == I2C_SUCCESS && value == 0x1801;
+    step_end("bus_recover", timed_out && recovered && _i2c.stats.timeouts == 1);
+
+    step_begin();
+    step_end("watchdog_time", watchdog_time() && _i2c.stats.timeouts == 1);
+
+    step_begin();
+    step_end("recover_uninit", recover_uninit());
+
+    step_begin();
+    step_end("deferred_start", deferred_start());
+
+    step_begin();
+    step_end("test_patterns", test_patterns((uint16_t *) HPS_0_BRIDGES_BASE));
+
+    step_begin();
+    step_end("pattern_refs", pattern_refs((uint16_t *) HPS_0_BRIDGES_BASE));
+
+    step_begin();
+    step_end("frame_queue", frame_queue());
+
+    step_begin();
+    step_end("downscale", downscale_check((uint16_t *) HPS_0_BRIDGES_BASE));
+
+    step_begin();
+    step_end("rgb888", rgb888_check((uint16_t *) HPS_0_BRIDGES_BASE));
+
+    step_begin();
+    step_end("checksums", checksum_check());
+
+    step_begin();
+    step_end("export_ppm", export_check((uint16_t *) HPS_0_BRIDGES_BASE));
+
+    printf("%u failures\n", _failures);
+    return _failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+#ifndef __ALT_ALARM_H__
+#define __ALT_ALARM_H__
+
+/* Host stand-in for the HAL's sys/alt_alarm.h
+ *
+ * Like the BSP (ALT_SYS_CLK none) there is no system clock: the tick rate
+ * stays 0 unless a driver calls alt_sysclk_init().
+ */
+
+#include <stdint.h>
+
+extern volatile uint32_t _alt_nticks;
+extern uint32_t _alt_tick_rate;
+
+static inline uint32_t alt_ticks_per_second(void)
+{
+    return _alt_tick_rate;
+}
+
+static inline int alt_sysclk_init(uint32_t nticks)
+{
+    if (!_alt_tick_rate) {
+        _alt_tick_rate = nticks;
+        return 0;
+    }
+    return -1;
+}
+
+static inline uint32_t alt_nticks(void)
+{
+    return _alt_nticks;
+}
+
+void alt_tick(void);
+
+#endif /* __ALT_ALARM_H__ */
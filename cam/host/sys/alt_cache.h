@@ -0,0 +1,22 @@
+#ifndef __ALT_CACHE_H__
+#define __ALT_CACHE_H__
+
+/* Host stand-in for the HAL's sys/alt_cache.h
+ *
+ * Host memory is coherent with the simulated peripherals: flushing and
+ * invalidating are no-ops.
+ */
+
+#include <stdint.h>
+
+static inline void alt_dcache_flush(void *start, uint32_t len)
+{
+    (void) start;
+    (void) len;
+}
+
+static inline void alt_dcache_flush_all(void)
+{
+}
+
+#endif /* __ALT_CACHE_H__ */
@@ -0,0 +1,26 @@
+#ifndef __ALT_IRQ_H__
+#define __ALT_IRQ_H__
+
+/* Host stand-in for the HAL's sys/alt_irq.h (enhanced interrupt API)
+ *
+ * Interrupts are emulated by alt_hal.c: a handler runs at the next device
+ * access after its line is raised, never nested, and never while interrupts
+ * are disabled.
+ */
+
+#include <stdint.h>
+
+typedef uint32_t alt_u32;
+typedef int alt_irq_context;
+typedef void (*alt_isr_func)(void *isr_context);
+
+alt_irq_context alt_irq_disable_all(void);
+void alt_irq_enable_all(alt_irq_context context);
+int alt_irq_enabled(void);
+
+int alt_ic_isr_register(alt_u32 ic_id, alt_u32 irq, alt_isr_func isr, void *isr_context, void *flags);
+int alt_ic_irq_enable(alt_u32 ic_id, alt_u32 irq);
+int alt_ic_irq_disable(alt_u32 ic_id, alt_u32 irq);
+alt_u32 alt_ic_irq_enabled(alt_u32 ic_id, alt_u32 irq);
+
+#endif /* __ALT_IRQ_H__ */
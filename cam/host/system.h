@@ -0,0 +1,67 @@
+/*
+ * system.h - host stand-in for the BSP's system.h
+ *
+ * Same peripheral map as cam_bsp/system.h, so that the application sources
+ * build unchanged on a Linux host. Peripheral registers are served by the
+ * simulators registered in board.c, see io.h.
+ */
+
+#ifndef __SYSTEM_H_
+#define __SYSTEM_H_
+
+/*
+ * CPU configuration
+ *
+ */
+
+#define ALT_CPU_FREQ 50000000
+#define ALT_CPU_DCACHE_LINE_SIZE 32
+#define ALT_CPU_DCACHE_SIZE 2048
+
+
+/*
+ * hal configuration
+ *
+ */
+
+#define ALT_SYS_CLK none
+#define ALT_TIMESTAMP_CLK none
+
+
+/*
+ * cam_controller_0 configuration
+ *
+ */
+
+#define CAM_CONTROLLER_0_BASE 0x10000820
+#define CAM_CONTROLLER_0_IRQ -1
+#define CAM_CONTROLLER_0_IRQ_INTERRUPT_CONTROLLER_ID -1
+#define CAM_CONTROLLER_0_SPAN 16
+
+
+/*
+ * hps_0_bridges configuration
+ *
+ * The host cannot map memory at 0x0, the bridge window is an anonymous
+ * mapping at a fixed address instead (see host_io_map_memory()), below 4 GB
+ * so that buffer addresses still fit the 32-bit CAM_IAR register.
+ *
+ */
+
+#define HPS_0_BRIDGES_BASE 0x40000000
+#define HPS_0_BRIDGES_IRQ -1
+#define HPS_0_BRIDGES_IRQ_INTERRUPT_CONTROLLER_ID -1
+#define HPS_0_BRIDGES_SPAN 268435456
+
+
+/*
+ * i2c_0 configuration
+ *
+ */
+
+#define I2C_0_BASE 0x10000808
+#define I2C_0_IRQ -1
+#define I2C_0_IRQ_INTERRUPT_CONTROLLER_ID -1
+#define I2C_0_SPAN 4
+
+#endif /* __SYSTEM_H_ */
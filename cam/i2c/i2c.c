@@ -12,13 +12,33 @@
 
 #define I2C_SLEEP_US (5000)
 
+/*
+ * Timeout of a byte transfer, in byte times (9 SCL periods). The budget is
+ * counted in status reads, each taking at least one controller clock cycle,
+ * so it is never shorter than this as long as the CPU does not run faster
+ * than the controller.
+ */
+#define I2C_TIMEOUT_BYTES         (16)
+#define I2C_TIMEOUT_POLLS_DEFAULT (1000000) /* before i2c_init() */
+
 /*******************************************************************************
  *  Private API
  ******************************************************************************/
 static void i2c_usleep(unsigned int useconds);
-static void wait_end_of_transfer(i2c_dev *dev);
-static void set_data_control(i2c_dev *dev, uint8_t data, uint8_t control);
-static uint8_t get_data_set_control(i2c_dev *dev, uint8_t control);
+static int wait_end_of_transfer(i2c_dev *dev);
+static void bus_recover(i2c_dev *dev);
+static int set_data_control(i2c_dev *dev, uint8_t data, uint8_t control);
+static int get_data_set_control(i2c_dev *dev, uint8_t control, uint8_t *data);
+static uint32_t transaction_begin(i2c_dev *dev);
+static void update_timeout_ticks(i2c_dev *dev);
+static int transaction_end(i2c_dev *dev, uint32_t start, unsigned int bytes, int status);
+static int do_write(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t value);
+static int do_read(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value);
+static int do_write_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value, unsigned int size);
+static int do_read_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value, unsigned int size);
+static void async_issue(i2c_dev *dev, uint8_t data, uint8_t control);
+static void async_finish(i2c_dev *dev, int status);
+static void async_step(i2c_dev *dev);
 
 /* Function to put the host processor to sleep for microseconds */
 static void i2c_usleep(unsigned int useconds) {
@@ -32,10 +52,43 @@ static void i2c_usleep(unsigned int useconds) {
 /*
  * wait_end_of_transfer
  *
- * Waits until the current i2c transfer is finished.
+ * Waits until the current i2c transfer is finished, for at most
+ * dev->timeout_polls status reads. On timeout the bus is recovered.
+ *
+ * Returns: I2C_SUCCESS  -> transfer finished
+ *          I2C_ETIMEOUT -> transfer did not finish in time
+ */
+static int wait_end_of_transfer(i2c_dev *dev) {
+    uint32_t polls = dev->timeout_polls;
+
+    while (I2C_RD_STATUS(dev->base) & I2C_STATUS_TRANSFER_IN_PROGRESS_MSK) {
+        if (polls-- == 0) {
+            bus_recover(dev);
+            return I2C_ETIMEOUT;
+        }
+    }
+    return I2C_SUCCESS;
+}
+
+/*
+ * bus_recover
+ *
+ * Recovers from a stuck transfer: generates a stop sequence, then rewrites
+ * the clock divisor which resets the controller's bit timing. Before
+ * i2c_init() no divisor is known, and the register is left as it is.
  */
-static void wait_end_of_transfer(i2c_dev *dev) {
-    while (I2C_RD_STATUS(dev->base) & I2C_STATUS_TRANSFER_IN_PROGRESS_MSK);
+static void bus_recover(i2c_dev *dev) {
+    uint32_t polls = dev->timeout_polls;
+
+    dev->stats.timeouts++;
+
+    I2C_WR_CONTROL(dev->base, I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK);
+    while ((I2C_RD_STATUS(dev->base) & I2C_STATUS_TRANSFER_IN_PROGRESS_MSK) && polls-- > 0);
+
+    if (dev->divisor != 0) {
+        I2C_WR_CLOCK_DIVISOR(dev->base, dev->divisor);
+    }
+    I2C_WR_CONTROL(dev->base, 0);
 }
 
 /*
@@ -44,11 +97,15 @@ static void wait_end_of_transfer(i2c_dev *dev) {
  * Writes the supplied "data" argument to SDA while using the control sequences
  * provided in argument "control".
  */
-static void set_data_control(i2c_dev *dev, uint8_t data, uint8_t control) {
-    wait_end_of_transfer(dev);
+static int set_data_control(i2c_dev *dev, uint8_t data, uint8_t control) {
+    int status = wait_end_of_transfer(dev);
+
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
     I2C_WR_DATA(dev->base, data);
     I2C_WR_CONTROL(dev->base, control);
-    wait_end_of_transfer(dev);
+    return wait_end_of_transfer(dev);
 }
 
 /*
@@ -57,76 +114,85 @@ static void set_data_control(i2c_dev *dev, uint8_t data, uint8_t control) {
  * Reads data from SDA while using the control sequences provided in argument
  * "control".
  */
-static uint8_t get_data_set_control(i2c_dev *dev, uint8_t control) {
-    wait_end_of_transfer(dev);
+static int get_data_set_control(i2c_dev *dev, uint8_t control, uint8_t *data) {
+    int status = wait_end_of_transfer(dev);
+
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
     I2C_WR_CONTROL(dev->base, control);
-    wait_end_of_transfer(dev);
-    return I2C_RD_DATA(dev->base);
+    status = wait_end_of_transfer(dev);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
+    *data = I2C_RD_DATA(dev->base);
+    return I2C_SUCCESS;
 }
 
-/*******************************************************************************
- *  Public API
- ******************************************************************************/
 /*
- * i2c_inst
+ * transaction_begin
  *
- * Constructs a device structure.
+ * Returns the start time of a transaction.
  */
-i2c_dev i2c_inst(void *base) {
-    i2c_dev dev;
-
-    dev.base = base;
-
-    return dev;
+static uint32_t transaction_begin(i2c_dev *dev) {
+    return dev->timestamp ? dev->timestamp() : 0;
 }
 
 /*
- * i2c_init
+ * update_timeout_ticks
  *
- * Initializes the i2c interface by setting its clock divisor register. The
- * standard data rate for an I2C transfer is 100 kbits/s. However, in order to
- * meet the timing constraints of the protocol, the I2C controller needs to
- * operate 4 times faster. Therefore, one must set the clock divisor register to
- * i2c_frequency / (4 * 100 KHz).
+ * Converts the transfer timeout, I2C_TIMEOUT_BYTES byte times at the bus
+ * speed (standard mode before i2c_init()), to time source ticks.
  */
-void i2c_init(i2c_dev *dev, uint32_t i2c_frequency) {
-    I2C_WR_CLOCK_DIVISOR(dev->base, i2c_frequency / (4 * 100000));
-    i2c_usleep(I2C_SLEEP_US);
+static void update_timeout_ticks(i2c_dev *dev) {
+    uint32_t bus_speed = dev->bus_speed ? dev->bus_speed : I2C_SPEED_STANDARD;
+
+    dev->timeout_ticks = (uint64_t) dev->timestamp_freq * I2C_TIMEOUT_BYTES * 9 / bus_speed;
 }
 
 /*
- * i2c_configure
- *
- * Configure the controller.
+ * transaction_end
  *
- * Setting the irq paramater to true enables interrupt generation at the end of
- * a read/write transfer, and false disables interrupt generation.
+ * Accounts a finished transaction of "bytes" bytes in the device statistics
+ * and returns its status.
  */
-void i2c_configure(i2c_dev *dev, bool irq) {
-    uint32_t config = 0;
+static int transaction_end(i2c_dev *dev, uint32_t start, unsigned int bytes, int status) {
+    dev->stats.transactions++;
+    dev->stats.bytes += bytes;
+    if (status != I2C_SUCCESS) {
+        dev->stats.errors++;
+    }
 
-    if (irq) {
-        config |= I2C_CONTROL_INTERRUPT_ENABLE_MSK;
-    } else {
-        config &= ~I2C_CONTROL_INTERRUPT_ENABLE_MSK;
+    if (dev->timestamp) {
+        uint32_t duration = dev->timestamp() - start;
+
+        dev->stats.time_total += duration;
+        if (duration > dev->stats.time_max) {
+            dev->stats.time_max = duration;
+        }
     }
 
-    I2C_WR_CONTROL(dev->base, I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK);
-    I2C_WR_CONTROL(dev->base, config);
+    return status;
 }
 
 /*
- * i2c_write
+ * do_write
  *
  * Write an 8-bit value to the device's register through the i2c protocol.
  *
  * Returns: I2C_SUCCESS -> success
  *          I2C_ENODEV  -> device does not answer
  *          I2C_EBADACK -> bad acknowledge received
+ *          I2C_ETIMEOUT -> transfer timed out, bus recovered
  */
-int i2c_write(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t value) {
+static int do_write(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t value) {
+    int status;
+
     /* write to the device with the R/W bit set to 0 (write mode) */
-    set_data_control(dev, device & 0xFE, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    status = set_data_control(dev, device & 0xFE, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     /* error: device does not answer */
     if (I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK) {
@@ -135,7 +201,10 @@ int i2c_write(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t value) {
     }
 
     /* write register index to device */
-    set_data_control(dev, index, I2C_CONTROL_WRITE_COMMAND_MSK);
+    status = set_data_control(dev, index, I2C_CONTROL_WRITE_COMMAND_MSK);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     /* error: bad acknowledge */
     if (I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK) {
@@ -144,7 +213,10 @@ int i2c_write(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t value) {
     }
 
     /* write register data to device */
-    set_data_control(dev, value, I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    status = set_data_control(dev, value, I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     /* error: bad acknowledge */
     if (I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK) {
@@ -156,17 +228,23 @@ int i2c_write(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t value) {
 }
 
 /*
- * i2c_read
+ * do_read
  *
  * Read an 8-bit value from the device's register through the i2c protocol.
  *
  * Returns: I2C_SUCCESS -> success
  *          I2C_ENODEV  -> device does not answer
  *          I2C_EBADACK -> bad acknowledge received
+ *          I2C_ETIMEOUT -> transfer timed out, bus recovered
  */
-int i2c_read(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value) {
+static int do_read(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value) {
+    int status;
+
     /* write to the device with the R/W bit set to 0 (write mode) */
-    set_data_control(dev, device & 0xFE, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    status = set_data_control(dev, device & 0xFE, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     /* error: device does not answer */
     if (I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK) {
@@ -175,7 +253,10 @@ int i2c_read(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value) {
     }
 
     /* write register index to device */
-    set_data_control(dev, index, I2C_CONTROL_WRITE_COMMAND_MSK);
+    status = set_data_control(dev, index, I2C_CONTROL_WRITE_COMMAND_MSK);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     /* error: bad acknowledge */
     if (I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK) {
@@ -184,7 +265,10 @@ int i2c_read(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value) {
     }
 
     /* write to the device with the R/W bit set to 1 (read mode) */
-    set_data_control(dev, device | 0x01, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    status = set_data_control(dev, device | 0x01, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     /* error: device does not answer */
     if (I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK) {
@@ -193,13 +277,16 @@ int i2c_read(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value) {
     }
 
     /* Read the data. Attention: write I2C_CONTROL_ACKNOWLEDGE_READ_MSK to control register to send a N0_ACK */
-    *value = get_data_set_control(dev, I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK | I2C_CONTROL_READ_COMMAND_MSK | I2C_CONTROL_ACKNOWLEDGE_READ_MSK);
+    status = get_data_set_control(dev, I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK | I2C_CONTROL_READ_COMMAND_MSK | I2C_CONTROL_ACKNOWLEDGE_READ_MSK, value);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     return I2C_SUCCESS;
 }
 
 /*
- * i2c_write_array
+ * do_write_array
  *
  * Write an array of 8-bit values to the device's register through the i2c
  * protocol.
@@ -207,10 +294,16 @@ int i2c_read(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value) {
  * Returns: I2C_SUCCESS -> success
  *          I2C_ENODEV  -> device does not answer
  *          I2C_EBADACK -> bad acknowledge received
+ *          I2C_ETIMEOUT -> transfer timed out, bus recovered
  */
-int i2c_write_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value, unsigned int size) {
+static int do_write_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value, unsigned int size) {
+    int status;
+
     /* write to the device with the R/W bit set to 0 (write mode) */
-    set_data_control(dev, device & 0xFE, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    status = set_data_control(dev, device & 0xFE, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     /* error: device does not answer */
     if (I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK) {
@@ -219,7 +312,10 @@ int i2c_write_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value,
     }
 
     /* write register index to device */
-    set_data_control(dev, index, I2C_CONTROL_WRITE_COMMAND_MSK);
+    status = set_data_control(dev, index, I2C_CONTROL_WRITE_COMMAND_MSK);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     /* error: bad acknowledge */
     if (I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK) {
@@ -231,9 +327,15 @@ int i2c_write_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value,
     for (i = 0; i < size; i++) {
         /* write register data to device */
         if (i < size - 1) {
-            set_data_control(dev, value[i], I2C_CONTROL_WRITE_COMMAND_MSK);
+            status = set_data_control(dev, value[i], I2C_CONTROL_WRITE_COMMAND_MSK);
+            if (status != I2C_SUCCESS) {
+                return status;
+            }
         } else {
-            set_data_control(dev, value[i], I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+            status = set_data_control(dev, value[i], I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+            if (status != I2C_SUCCESS) {
+                return status;
+            }
 
         }
 
@@ -248,7 +350,7 @@ int i2c_write_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value,
 }
 
 /*
- * i2c_read_array
+ * do_read_array
  *
  * Reads an array of 8-bit values from the device's register through the i2c
  * protocol.
@@ -256,10 +358,16 @@ int i2c_write_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value,
  * Returns: I2C_SUCCESS -> success
  *          I2C_ENODEV  -> device does not answer
  *          I2C_EBADACK -> bad acknowledge received
+ *          I2C_ETIMEOUT -> transfer timed out, bus recovered
  */
-int i2c_read_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value, unsigned int size) {
+static int do_read_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value, unsigned int size) {
+    int status;
+
     /* write to the device with the R/W bit set to 0 (write mode) */
-    set_data_control(dev, device & 0xFE, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    status = set_data_control(dev, device & 0xFE, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     /* error: device does not answer */
     if (I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK) {
@@ -268,7 +376,10 @@ int i2c_read_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value,
     }
 
     /* write register index to device */
-    set_data_control(dev, index, I2C_CONTROL_WRITE_COMMAND_MSK);
+    status = set_data_control(dev, index, I2C_CONTROL_WRITE_COMMAND_MSK);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     /* error: bad acknowledge */
     if (I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK) {
@@ -277,7 +388,10 @@ int i2c_read_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value,
     }
 
     /* write to the device with the R/W bit set to 1 (read mode) */
-    set_data_control(dev, device | 0x01, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    status = set_data_control(dev, device | 0x01, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
 
     /* error: device does not answer */
     if (I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK) {
@@ -288,12 +402,449 @@ int i2c_read_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value,
     unsigned int i = 0;
     for (i = 0; i < size; i++) {
         if (i < size - 1) {
-            value[i] = get_data_set_control(dev, I2C_CONTROL_READ_COMMAND_MSK);
+            status = get_data_set_control(dev, I2C_CONTROL_READ_COMMAND_MSK, &value[i]);
+            if (status != I2C_SUCCESS) {
+                return status;
+            }
         } else {
             /* Read the data. Attention: write I2C_CONTROL_ACKNOWLEDGE_READ_MSK to control register to send a N0_ACK */
-            value[i] = get_data_set_control(dev, I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK | I2C_CONTROL_READ_COMMAND_MSK | I2C_CONTROL_ACKNOWLEDGE_READ_MSK);
+            status = get_data_set_control(dev, I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK | I2C_CONTROL_READ_COMMAND_MSK | I2C_CONTROL_ACKNOWLEDGE_READ_MSK, &value[i]);
+            if (status != I2C_SUCCESS) {
+                return status;
+            }
         }
     }
 
     return I2C_SUCCESS;
 }
+
+/* asynchronous transfer states, named after the byte that was just sent */
+#define XFER_ADDRESS        (0) /* device address, write mode */
+#define XFER_INDEX          (1) /* register index */
+#define XFER_READ_ADDRESS   (2) /* device address, read mode */
+#define XFER_WRITE_DATA     (3) /* data byte "pos" */
+#define XFER_READ_DATA      (4) /* data byte "pos" requested */
+#define XFER_START          (5) /* nothing sent, previous stop sequence on the bus */
+
+/*
+ * async_issue
+ *
+ * Starts a byte transfer with the end of transfer interrupt enabled. A
+ * command without data (read) ignores the "data" argument.
+ */
+static void async_issue(i2c_dev *dev, uint8_t data, uint8_t control) {
+    dev->current->polls = 0;
+    dev->current->issued = transaction_begin(dev);
+    if (control & I2C_CONTROL_WRITE_COMMAND_MSK) {
+        I2C_WR_DATA(dev->base, data);
+    }
+    I2C_WR_CONTROL(dev->base, control | I2C_CONTROL_INTERRUPT_ENABLE_MSK);
+}
+
+/*
+ * async_finish
+ *
+ * Completes the current asynchronous transfer. On acknowledge errors a stop
+ * sequence is generated (with the interrupt disabled). On success the last
+ * byte already carried it, and after a timeout bus_recover() did, so writing
+ * the control register only clears the interrupt.
+ */
+static void async_finish(i2c_dev *dev, int status) {
+    i2c_transfer *xfer = dev->current;
+
+    if (status == I2C_ENODEV || status == I2C_EBADACK) {
+        I2C_WR_CONTROL(dev->base, I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK);
+    } else {
+        I2C_WR_CONTROL(dev->base, 0);
+    }
+
+    transaction_end(dev, xfer->start, (xfer->read ? 3 : 2) + xfer->pos, status);
+    dev->current = NULL;
+    xfer->status = status;
+
+    if (xfer->callback) {
+        xfer->callback(xfer, status);
+    }
+    if (dev->idle) {
+        dev->idle(dev, dev->idle_arg);
+    }
+}
+
+/*
+ * async_timed_out
+ *
+ * Watchdog of the byte transfer in progress, or of the stop sequence delaying
+ * a pending start. With a time source it expires dev->timeout_ticks after the
+ * byte was issued (the transfer was submitted), whatever the polling rate.
+ * Without, only dev->timeout_polls calls bound it.
+ */
+static bool async_timed_out(i2c_dev *dev, i2c_transfer *xfer) {
+    if (dev->timeout_ticks != 0) {
+        return dev->timestamp() - xfer->issued > dev->timeout_ticks;
+    }
+    return ++xfer->polls > dev->timeout_polls;
+}
+
+/*
+ * async_step
+ *
+ * Advances the state machine of the current asynchronous transfer after the
+ * previous byte transfer ended.
+ */
+static void async_step(i2c_dev *dev) {
+    i2c_transfer *xfer = dev->current;
+    bool nack = I2C_RD_STATUS(dev->base) & I2C_STATUS_LAST_ACKNOWLEDGE_RECEIVED_MSK;
+    uint8_t stop;
+
+    switch (xfer->state) {
+    case XFER_START:
+        xfer->state = XFER_ADDRESS;
+        /* write to the device with the R/W bit set to 0 (write mode) */
+        async_issue(dev, xfer->device & 0xFE, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+        break;
+
+    case XFER_ADDRESS:
+        if (nack) {
+            async_finish(dev, I2C_ENODEV);
+            return;
+        }
+        xfer->state = XFER_INDEX;
+        async_issue(dev, xfer->index, I2C_CONTROL_WRITE_COMMAND_MSK);
+        break;
+
+    case XFER_INDEX:
+        if (nack) {
+            async_finish(dev, I2C_EBADACK);
+            return;
+        }
+        if (xfer->read) {
+            xfer->state = XFER_READ_ADDRESS;
+            async_issue(dev, xfer->device | 0x01, I2C_CONTROL_GENERATE_START_SEQUENCE_MSK | I2C_CONTROL_WRITE_COMMAND_MSK);
+        } else {
+            xfer->state = XFER_WRITE_DATA;
+            stop = (xfer->size == 1) ? I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK : 0;
+            async_issue(dev, xfer->data[0], stop | I2C_CONTROL_WRITE_COMMAND_MSK);
+        }
+        break;
+
+    case XFER_READ_ADDRESS:
+        if (nack) {
+            async_finish(dev, I2C_ENODEV);
+            return;
+        }
+        xfer->state = XFER_READ_DATA;
+        /* Attention: write I2C_CONTROL_ACKNOWLEDGE_READ_MSK to control register to send a N0_ACK */
+        stop = (xfer->size == 1) ? I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK | I2C_CONTROL_ACKNOWLEDGE_READ_MSK : 0;
+        async_issue(dev, 0, stop | I2C_CONTROL_READ_COMMAND_MSK);
+        break;
+
+    case XFER_WRITE_DATA:
+        if (nack) {
+            async_finish(dev, I2C_EBADACK);
+            return;
+        }
+        xfer->pos++;
+        if (xfer->pos == xfer->size) {
+            async_finish(dev, I2C_SUCCESS);
+            return;
+        }
+        stop = (xfer->pos == xfer->size - 1) ? I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK : 0;
+        async_issue(dev, xfer->data[xfer->pos], stop | I2C_CONTROL_WRITE_COMMAND_MSK);
+        break;
+
+    case XFER_READ_DATA:
+        xfer->data[xfer->pos++] = I2C_RD_DATA(dev->base);
+        if (xfer->pos == xfer->size) {
+            async_finish(dev, I2C_SUCCESS);
+            return;
+        }
+        stop = (xfer->pos == xfer->size - 1) ? I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK | I2C_CONTROL_ACKNOWLEDGE_READ_MSK : 0;
+        async_issue(dev, 0, stop | I2C_CONTROL_READ_COMMAND_MSK);
+        break;
+
+    default:
+        async_finish(dev, I2C_EINVAL);
+        break;
+    }
+}
+
+/*******************************************************************************
+ *  Public API
+ ******************************************************************************/
+/*
+ * i2c_inst
+ *
+ * Constructs a device structure.
+ */
+i2c_dev i2c_inst(void *base) {
+    i2c_dev dev = {0};
+
+    dev.base = base;
+    dev.timeout_polls = I2C_TIMEOUT_POLLS_DEFAULT;
+
+    return dev;
+}
+
+/*
+ * i2c_init
+ *
+ * Initializes the i2c interface for standard mode (100 kbits/s).
+ *
+ * Returns: I2C_SUCCESS -> success
+ *          I2C_EINVAL  -> divisor out of range for i2c_frequency
+ */
+int i2c_init(i2c_dev *dev, uint32_t i2c_frequency) {
+    return i2c_init_speed(dev, i2c_frequency, I2C_SPEED_STANDARD);
+}
+
+/*
+ * i2c_init_speed
+ *
+ * Initializes the i2c interface by setting its clock divisor register. In
+ * order to meet the timing constraints of the protocol, the I2C controller
+ * needs to operate 4 times faster than the bus. Therefore, one must set the
+ * clock divisor register to i2c_frequency / (4 * bus_speed). The divisor is
+ * rounded up so that the bus never runs faster than requested.
+ *
+ * Returns: I2C_SUCCESS -> success
+ *          I2C_EINVAL  -> bus_speed above fast mode or divisor out of range
+ */
+int i2c_init_speed(i2c_dev *dev, uint32_t i2c_frequency, uint32_t bus_speed) {
+    uint32_t divisor;
+
+    if (bus_speed == 0 || bus_speed > I2C_SPEED_FAST) {
+        return I2C_EINVAL;
+    }
+
+    divisor = (i2c_frequency + 4 * bus_speed - 1) / (4 * bus_speed);
+
+    /* the clock divisor register is 8 bits wide */
+    if (divisor == 0 || divisor > 0xFF) {
+        return I2C_EINVAL;
+    }
+
+    I2C_WR_CLOCK_DIVISOR(dev->base, divisor);
+    dev->divisor = divisor;
+    dev->bus_speed = i2c_frequency / (4 * divisor);
+    dev->timeout_polls = I2C_TIMEOUT_BYTES * 9 * 4 * divisor;
+    update_timeout_ticks(dev);
+    i2c_usleep(I2C_SLEEP_US);
+
+    return I2C_SUCCESS;
+}
+
+/*
+ * i2c_set_timestamp
+ *
+ * Sets the time source, counting at "freq" Hz, used to measure transaction
+ * durations and to time out asynchronous transfers. NULL disables timing,
+ * transactions and bytes are still counted and the asynchronous timeout
+ * falls back to counting polls.
+ */
+void i2c_set_timestamp(i2c_dev *dev, uint32_t (*timestamp)(void), uint32_t freq) {
+    dev->timestamp = timestamp;
+    dev->timestamp_freq = timestamp ? freq : 0;
+    update_timeout_ticks(dev);
+}
+
+/*
+ * i2c_reset_stats
+ *
+ * Clears the transaction statistics.
+ */
+void i2c_reset_stats(i2c_dev *dev) {
+    dev->stats = (i2c_stats) {0};
+}
+
+/*
+ * i2c_configure
+ *
+ * Configure the controller.
+ *
+ * Setting the irq paramater to true enables interrupt generation at the end of
+ * a read/write transfer, and false disables interrupt generation.
+ */
+void i2c_configure(i2c_dev *dev, bool irq) {
+    uint32_t config = 0;
+
+    if (irq) {
+        config |= I2C_CONTROL_INTERRUPT_ENABLE_MSK;
+    } else {
+        config &= ~I2C_CONTROL_INTERRUPT_ENABLE_MSK;
+    }
+
+    I2C_WR_CONTROL(dev->base, I2C_CONTROL_GENERATE_STOP_SEQUENCE_MSK);
+    I2C_WR_CONTROL(dev->base, config);
+}
+
+/*
+ * i2c_write
+ *
+ * Write an 8-bit value to the device's register through the i2c protocol.
+ *
+ * Returns: I2C_SUCCESS -> success
+ *          I2C_ENODEV  -> device does not answer
+ *          I2C_EBADACK -> bad acknowledge received
+ *          I2C_EBUSY   -> asynchronous transfer in progress
+ *          I2C_ETIMEOUT -> transfer timed out, bus recovered
+ */
+int i2c_write(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t value) {
+    if (dev->current != NULL) {
+        return I2C_EBUSY;
+    }
+
+    uint32_t start = transaction_begin(dev);
+    return transaction_end(dev, start, 3, do_write(dev, device, index, value));
+}
+
+/*
+ * i2c_read
+ *
+ * Read an 8-bit value from the device's register through the i2c protocol.
+ *
+ * Returns: I2C_SUCCESS -> success
+ *          I2C_ENODEV  -> device does not answer
+ *          I2C_EBADACK -> bad acknowledge received
+ *          I2C_EBUSY   -> asynchronous transfer in progress
+ *          I2C_ETIMEOUT -> transfer timed out, bus recovered
+ */
+int i2c_read(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value) {
+    if (dev->current != NULL) {
+        return I2C_EBUSY;
+    }
+
+    uint32_t start = transaction_begin(dev);
+    return transaction_end(dev, start, 4, do_read(dev, device, index, value));
+}
+
+/*
+ * i2c_write_array
+ *
+ * Write an array of 8-bit values to the device's register through the i2c
+ * protocol.
+ *
+ * Returns: I2C_SUCCESS -> success
+ *          I2C_ENODEV  -> device does not answer
+ *          I2C_EBADACK -> bad acknowledge received
+ *          I2C_EBUSY   -> asynchronous transfer in progress
+ *          I2C_ETIMEOUT -> transfer timed out, bus recovered
+ */
+int i2c_write_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value, unsigned int size) {
+    if (dev->current != NULL) {
+        return I2C_EBUSY;
+    }
+
+    uint32_t start = transaction_begin(dev);
+    return transaction_end(dev, start, 2 + size, do_write_array(dev, device, index, value, size));
+}
+
+/*
+ * i2c_read_array
+ *
+ * Reads an array of 8-bit values from the device's register through the i2c
+ * protocol.
+ *
+ * Returns: I2C_SUCCESS -> success
+ *          I2C_ENODEV  -> device does not answer
+ *          I2C_EBADACK -> bad acknowledge received
+ *          I2C_EBUSY   -> asynchronous transfer in progress
+ *          I2C_ETIMEOUT -> transfer timed out, bus recovered
+ */
+int i2c_read_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value, unsigned int size) {
+    if (dev->current != NULL) {
+        return I2C_EBUSY;
+    }
+
+    uint32_t start = transaction_begin(dev);
+    return transaction_end(dev, start, 3 + size, do_read_array(dev, device, index, value, size));
+}
+
+/*
+ * i2c_submit
+ *
+ * Starts an asynchronous transfer. The transfer advances one byte per
+ * i2c_handle_irq() call that finds the previous byte done (polled, or on the
+ * end of transfer interrupt), and completes with a call to
+ * xfer->callback (from the context running i2c_handle_irq()). xfer->status
+ * reads I2C_EBUSY until the transfer is finished.
+ *
+ * Never waits, so that it can be called from interrupt context: if the stop
+ * sequence that ended a failed transfer is still on the bus, the start is
+ * left to the next i2c_handle_irq() call that finds the bus idle. No
+ * interrupt signals the end of that stop sequence, i2c_handle_irq() must be
+ * polled to issue it (see i2c_queue_poll()).
+ *
+ * Returns: I2C_SUCCESS  -> transfer started or pending
+ *          I2C_EBUSY    -> another asynchronous transfer is in progress
+ *          I2C_EINVAL   -> empty transfer
+ */
+int i2c_submit(i2c_dev *dev, i2c_transfer *xfer) {
+    if (dev->current != NULL) {
+        return I2C_EBUSY;
+    }
+    if (xfer->size == 0) {
+        return I2C_EINVAL;
+    }
+
+    xfer->status = I2C_EBUSY;
+    xfer->state = XFER_START;
+    xfer->pos = 0;
+    xfer->polls = 0;
+    xfer->start = transaction_begin(dev);
+    xfer->issued = xfer->start;
+
+    dev->current = xfer;
+    /* a previous stop sequence may still be on the bus */
+    if (!(I2C_RD_STATUS(dev->base) & I2C_STATUS_TRANSFER_IN_PROGRESS_MSK)) {
+        async_step(dev);
+    }
+
+    return I2C_SUCCESS;
+}
+
+/*
+ * i2c_handle_irq
+ *
+ * Advances the asynchronous transfer in progress. Poll it from the main loop,
+ * which is what drives the transfers without i2c interrupt, and call it from
+ * the i2c interrupt handler when one is connected. It returns immediately
+ * while a byte transfer is in progress. When polled, it also acts as a
+ * watchdog, which the interrupt cannot do: a byte transfer (or the stop
+ * sequence delaying a pending start) still in progress after the timeout,
+ * see async_timed_out(), ends the transfer with I2C_ETIMEOUT.
+ */
+void i2c_handle_irq(i2c_dev *dev) {
+    i2c_transfer *xfer = dev->current;
+
+    if (xfer == NULL) {
+        return;
+    }
+    if (I2C_RD_STATUS(dev->base) & I2C_STATUS_TRANSFER_IN_PROGRESS_MSK) {
+        if (async_timed_out(dev, xfer)) {
+            bus_recover(dev);
+            async_finish(dev, I2C_ETIMEOUT);
+        }
+        return;
+    }
+    async_step(dev);
+}
+
+/*
+ * i2c_busy
+ *
+ * Returns true while an asynchronous transfer is in progress.
+ */
+bool i2c_busy(i2c_dev *dev) {
+    return dev->current != NULL;
+}
+
+/*
+ * i2c_set_idle_callback
+ *
+ * Sets a function called after each asynchronous transfer completion (after
+ * the transfer's own callback), typically to start the next queued transfer.
+ */
+void i2c_set_idle_callback(i2c_dev *dev, void (*idle)(i2c_dev *dev, void *arg), void *arg) {
+    dev->idle = idle;
+    dev->idle_arg = arg;
+}
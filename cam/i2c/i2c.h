@@ -8,9 +8,49 @@
 #include <stdbool.h>
 #endif
 
+/* i2c transaction statistics */
+typedef struct i2c_stats {
+    uint32_t transactions; /* number of transactions */
+    uint32_t errors;       /* number of failed transactions */
+    uint32_t bytes;        /* bytes on the bus, including address and index */
+    uint32_t time_total;   /* sum of transaction durations (timestamp units) */
+    uint32_t time_max;     /* longest transaction (timestamp units) */
+    uint32_t timeouts;     /* number of bus recoveries after a timeout */
+} i2c_stats;
+
+/* asynchronous transfer descriptor, see i2c_submit() */
+typedef struct i2c_transfer {
+    uint8_t device;              /* device address */
+    uint8_t index;               /* register index */
+    bool read;                   /* read "size" bytes instead of writing them */
+    uint8_t *data;
+    unsigned int size;           /* at least 1 byte */
+    void (*callback)(struct i2c_transfer *xfer, int status); /* optional */
+    void *arg;                   /* free for the callback */
+
+    /* private */
+    volatile int status;         /* I2C_EBUSY while in progress */
+    unsigned int state;
+    unsigned int pos;
+    uint32_t polls;
+    uint32_t issued;             /* time the byte in progress was issued */
+    uint32_t start;
+    struct i2c_transfer *next;   /* used by i2c_queue */
+} i2c_transfer;
+
 /* i2c device structure */
 typedef struct i2c_dev {
-    void *base; /* Base address of component */
+    void *base;                  /* Base address of component */
+    uint32_t bus_speed;          /* Effective SCL frequency in Hz */
+    uint8_t divisor;             /* Clock divisor register value */
+    uint32_t timeout_polls;      /* Status reads before a transfer times out */
+    uint32_t (*timestamp)(void); /* Optional time source for statistics and timeouts */
+    uint32_t timestamp_freq;     /* Time source frequency in Hz */
+    uint32_t timeout_ticks;      /* Time source ticks before a byte transfer times out, 0 if none */
+    i2c_stats stats;
+    i2c_transfer *volatile current; /* Asynchronous transfer in progress */
+    void (*idle)(struct i2c_dev *dev, void *arg); /* Called when an asynchronous transfer ends */
+    void *idle_arg;
 } i2c_dev;
 
 /*******************************************************************************
@@ -19,6 +59,13 @@ typedef struct i2c_dev {
 #define I2C_SUCCESS (0) /* success */
 #define I2C_ENODEV  (1) /* no such device */
 #define I2C_EBADACK (2) /* bad acknowledge */
+#define I2C_EINVAL  (3) /* invalid argument */
+#define I2C_EBUSY   (4) /* asynchronous transfer in progress */
+#define I2C_ETIMEOUT (5) /* transfer did not finish, bus recovered */
+
+/* Bus speeds, any other frequency up to I2C_SPEED_FAST can be used */
+#define I2C_SPEED_STANDARD (100000) /* standard mode, 100 kHz */
+#define I2C_SPEED_FAST     (400000) /* fast mode, 400 kHz */
 
 i2c_dev i2c_inst(void *base);
 
@@ -30,7 +77,10 @@ i2c_dev i2c_inst(void *base);
 #define I2C_INST(prefix)               \
     i2c_inst((void *) prefix ## _BASE)
 
-void i2c_init(i2c_dev *dev, uint32_t i2c_frequency);
+int i2c_init(i2c_dev *dev, uint32_t i2c_frequency);
+int i2c_init_speed(i2c_dev *dev, uint32_t i2c_frequency, uint32_t bus_speed);
+void i2c_set_timestamp(i2c_dev *dev, uint32_t (*timestamp)(void), uint32_t freq);
+void i2c_reset_stats(i2c_dev *dev);
 
 void i2c_configure(i2c_dev *dev, bool irq);
 int i2c_write(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t value);
@@ -38,4 +88,9 @@ int i2c_read(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value);
 int i2c_write_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value, unsigned int size);
 int i2c_read_array(i2c_dev *dev, uint8_t device, uint8_t index, uint8_t *value, unsigned int size);
 
+int i2c_submit(i2c_dev *dev, i2c_transfer *xfer);
+void i2c_handle_irq(i2c_dev *dev);
+bool i2c_busy(i2c_dev *dev);
+void i2c_set_idle_callback(i2c_dev *dev, void (*idle)(i2c_dev *dev, void *arg), void *arg);
+
 #endif /* __I2C_H__ */
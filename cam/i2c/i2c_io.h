@@ -1,7 +1,9 @@
 #ifndef __I2C_IO_H__
 #define __I2C_IO_H__
 
-#ifdef __nios2_arch__
+/* The host build (HOST_SIM) provides an io.h routing register accesses to
+ * the simulated controller. */
+#if defined(__nios2_arch__) || defined(HOST_SIM)
 #include "io.h"
 
 #define i2c_write_byte(dest, src) (IOWR_8DIRECT((dest), 0, (src)))
@@ -0,0 +1,203 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <sys/alt_irq.h>
+
+#include "i2c.h"
+#include "i2c_queue.h"
+
+/*
+ * The queue is shared between the submitting code and whatever runs
+ * i2c_handle_irq(), which starts the next transfer when the previous one
+ * completes: the main loop through i2c_queue_poll(), or the i2c interrupt
+ * when it is connected. It is always updated with interrupts disabled, the
+ * host simulator included, which delivers interrupts asynchronously and
+ * provides the same alt_irq_disable_all() / alt_irq_enable_all().
+ */
+#define QUEUE_LOCK()    alt_irq_context queue_ctx = alt_irq_disable_all()
+#define QUEUE_UNLOCK()  alt_irq_enable_all(queue_ctx)
+
+/*******************************************************************************
+ *  Private API
+ ******************************************************************************/
+static void queue_start_next(i2c_queue *queue);
+static void queue_idle(i2c_dev *dev, void *arg);
+
+/*
+ * queue_start_next
+ *
+ * Starts the oldest transfer of the highest non-empty priority level if the
+ * device is idle. Transfers that fail to start are completed with their
+ * error status. Must be called with the queue locked.
+ */
+static void queue_start_next(i2c_queue *queue) {
+    unsigned int prio;
+
+    while (!i2c_busy(queue->dev)) {
+        i2c_transfer *xfer = NULL;
+
+        for (prio = 0; prio < I2C_QUEUE_NB_PRIO; prio++) {
+            if (queue->head[prio] != NULL) {
+                xfer = queue->head[prio];
+                queue->head[prio] = xfer->next;
+                if (queue->head[prio] == NULL) {
+                    queue->tail[prio] = NULL;
+                }
+                break;
+            }
+        }
+
+        if (xfer == NULL) {
+            return;
+        }
+
+        int status = i2c_submit(queue->dev, xfer);
+        if (status != I2C_SUCCESS) {
+            xfer->status = status;
+            if (xfer->callback) {
+                xfer->callback(xfer, status);
+            }
+        }
+    }
+}
+
+/*
+ * queue_idle
+ *
+ * Device idle callback, preempts lower priority transfers at transaction
+ * boundaries.
+ */
+static void queue_idle(i2c_dev *dev, void *arg) {
+    (void) dev;
+    queue_start_next((i2c_queue *) arg);
+}
+
+/*******************************************************************************
+ *  Public API
+ ******************************************************************************/
+/*
+ * i2c_queue_init
+ *
+ * Initializes a transaction queue in front of "dev". All asynchronous users
+ * of "dev" must go through the queue afterwards.
+ */
+void i2c_queue_init(i2c_queue *queue, i2c_dev *dev) {
+    unsigned int prio;
+
+    queue->dev = dev;
+    for (prio = 0; prio < I2C_QUEUE_NB_PRIO; prio++) {
+        queue->head[prio] = NULL;
+        queue->tail[prio] = NULL;
+    }
+
+    queue->wait = NULL;
+    queue->wait_arg = NULL;
+
+    i2c_set_idle_callback(dev, queue_idle, queue);
+}
+
+/*
+ * i2c_queue_submit
+ *
+ * Appends a transfer to the queue of priority "prio" and starts it if the
+ * bus is idle. xfer->callback is called on completion.
+ *
+ * Returns: I2C_SUCCESS -> transfer queued
+ *          I2C_EINVAL  -> invalid priority or empty transfer
+ */
+int i2c_queue_submit(i2c_queue *queue, i2c_transfer *xfer, unsigned int prio) {
+    if (prio >= I2C_QUEUE_NB_PRIO || xfer->size == 0) {
+        return I2C_EINVAL;
+    }
+
+    xfer->status = I2C_EBUSY;
+    xfer->next = NULL;
+
+    QUEUE_LOCK();
+    if (queue->tail[prio] != NULL) {
+        queue->tail[prio]->next = xfer;
+    } else {
+        queue->head[prio] = xfer;
+    }
+    queue->tail[prio] = xfer;
+
+    queue_start_next(queue);
+    QUEUE_UNLOCK();
+
+    return I2C_SUCCESS;
+}
+
+/*
+ * i2c_queue_run
+ *
+ * Queues a transfer and waits for its completion, polling the device to drive
+ * it. This blocks for the whole bus time of the transfers ahead and of this
+ * one, so keep it for setup and diagnostics and use i2c_queue_submit() for
+ * the per frame writes. The wait function set by i2c_queue_set_wait() runs
+ * between polls. Must not be called from interrupt context.
+ *
+ * Returns: the transfer status, see i2c_read_array() / i2c_write_array()
+ */
+int i2c_queue_run(i2c_queue *queue, i2c_transfer *xfer, unsigned int prio) {
+    int status = i2c_queue_submit(queue, xfer, prio);
+
+    if (status != I2C_SUCCESS) {
+        return status;
+    }
+
+    while (xfer->status == I2C_EBUSY) {
+        i2c_queue_poll(queue);
+        if (queue->wait != NULL) {
+            queue->wait(queue->wait_arg);
+        }
+    }
+
+    return xfer->status;
+}
+
+/*
+ * i2c_queue_poll
+ *
+ * Advances the transfer in progress by at most one byte step and returns,
+ * call it regularly from the main loop. This is what drives the transfers
+ * when the i2c interrupt is not connected (the case of the shipped design).
+ * With the interrupt, polling is still needed to time out a stuck transfer
+ * and to start a transfer that had to wait for the bus to be idle, see
+ * i2c_submit().
+ */
+void i2c_queue_poll(i2c_queue *queue) {
+    QUEUE_LOCK();
+    i2c_handle_irq(queue->dev);
+    QUEUE_UNLOCK();
+}
+
+/*
+ * i2c_queue_set_wait
+ *
+ * Sets a function run by i2c_queue_run() between two polls of the device, to
+ * keep background work going during synchronous transfers. NULL removes it.
+ */
+void i2c_queue_set_wait(i2c_queue *queue, void (*wait)(void *arg), void *arg) {
+    queue->wait = wait;
+    queue->wait_arg = arg;
+}
+
+/*
+ * i2c_queue_empty
+ *
+ * Returns true if no transfer is queued or in progress.
+ */
+bool i2c_queue_empty(i2c_queue *queue) {
+    unsigned int prio;
+
+    if (i2c_busy(queue->dev)) {
+        return false;
+    }
+    for (prio = 0; prio < I2C_QUEUE_NB_PRIO; prio++) {
+        if (queue->head[prio] != NULL) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#ifndef __I2C_QUEUE_H__
+#define __I2C_QUEUE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "i2c.h"
+
+/* Priority levels, lower value is served first */
+#define I2C_QUEUE_PRIO_HIGH (0) /* time critical, e.g. per frame exposure updates */
+#define I2C_QUEUE_PRIO_LOW  (1) /* configuration, register dumps */
+#define I2C_QUEUE_NB_PRIO   (2)
+
+/* i2c transaction queue structure */
+typedef struct i2c_queue {
+    i2c_dev *dev;
+    i2c_transfer *head[I2C_QUEUE_NB_PRIO];
+    i2c_transfer *tail[I2C_QUEUE_NB_PRIO];
+    void (*wait)(void *arg); /* run by i2c_queue_run() between polls */
+    void *wait_arg;
+} i2c_queue;
+
+/*******************************************************************************
+ *  Public API
+ ******************************************************************************/
+void i2c_queue_init(i2c_queue *queue, i2c_dev *dev);
+int i2c_queue_submit(i2c_queue *queue, i2c_transfer *xfer, unsigned int prio);
+int i2c_queue_run(i2c_queue *queue, i2c_transfer *xfer, unsigned int prio);
+void i2c_queue_poll(i2c_queue *queue);
+void i2c_queue_set_wait(i2c_queue *queue, void (*wait)(void *arg), void *arg);
+bool i2c_queue_empty(i2c_queue *queue);
+
+#endif /* __I2C_QUEUE_H__ */
@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <io.h>
+#include <sys/alt_cache.h>
+#include "camera.h"
+#include "image.h"
+#include "image_compare.h"
+
+bool compare_image_to_default(uint16_t *image, uint16_t default_value)
+{
+    /* compare image buffer */
+    uint32_t i = image_find_diff(image, IMAGE_SIZE, default_value);
+    if (i != IMAGE_DIFF_NONE) {
+        printf("difference found at image[%lu] = %x\n", (unsigned long) i, IORD_16DIRECT(image, 2*i));
+        return true;
+    }
+    return false;
+}
+
+void clear_image_buffer(uint16_t *addr, uint16_t fill)
+{
+    image_fill(addr, IMAGE_SIZE, fill, IMAGE_FILL_PATH);
+}
+
+/* Fill engine
+ *
+ * Writes two pixels per 32-bit store, eight stores (one data cache line)
+ * per loop iteration:
+ *  - IMAGE_FILL_UNCACHED: I/O stores, one bus transaction per word, nothing
+ *    left in the cache.
+ *  - IMAGE_FILL_CACHED: plain stores, written back by alt_dcache_flush() in
+ *    line sized bursts. The flush also invalidates the lines, so that the
+ *    buffer can be handed to the camera right away.
+ * The host build does not model the data cache nor the HPS bridge, so its
+ * benchmark figures say nothing about which path is faster on the board.
+ * addr must be 32-bit aligned, size is in bytes.
+ */
+#define FILL_UNROLL 8
+
+static void fill_uncached(uint16_t *addr, size_t words, uint32_t word)
+{
+    size_t off = 0;
+    size_t end = 4 * (words - words % FILL_UNROLL);
+
+    for (; off < end; off += 4 * FILL_UNROLL) {
+        IOWR_32DIRECT(addr, off, word);
+        IOWR_32DIRECT(addr, off + 4, word);
+        IOWR_32DIRECT(addr, off + 8, word);
+        IOWR_32DIRECT(addr, off + 12, word);
+        IOWR_32DIRECT(addr, off + 16, word);
+        IOWR_32DIRECT(addr, off + 20, word);
+        IOWR_32DIRECT(addr, off + 24, word);
+        IOWR_32DIRECT(addr, off + 28, word);
+    }
+    for (; off < 4 * words; off += 4) {
+        IOWR_32DIRECT(addr, off, word);
+    }
+}
+
+static void fill_cached(uint16_t *addr, size_t words, uint32_t word)
+{
+    uint32_t *p = (uint32_t *) addr;
+    uint32_t *end = p + (words - words % FILL_UNROLL);
+
+    for (; p < end; p += FILL_UNROLL) {
+        p[0] = word;
+        p[1] = word;
+        p[2] = word;
+        p[3] = word;
+        p[4] = word;
+        p[5] = word;
+        p[6] = word;
+        p[7] = word;
+    }
+    for (end += words % FILL_UNROLL; p < end; p++) {
+        *p = word;
+    }
+    alt_dcache_flush(addr, 4 * words);
+}
+
+void image_fill(uint16_t *addr, size_t size, uint16_t fill, image_fill_path path)
+{
+    size_t words = size / 4;
+    uint32_t word = (uint32_t) fill << 16 | fill;
+
+    if (path == IMAGE_FILL_CACHED) {
+        fill_cached(addr, words, word);
+    } else {
+        fill_uncached(addr, words, word);
+    }
+    if (size & 2) {
+        IOWR_16DIRECT(addr, 4 * words, fill);
+    }
+}
+
+uint16_t get_pixel_xy(uint16_t *image, unsigned x, unsigned y)
+{
+    return IORD_16DIRECT(image, 2*(x + IMAGE_WIDTH*y));
+}
+
+/* Formats the dx x dy pixels at (x0, y0) as hex, one line per row, into
+ * buf (size bytes, IMAGE_XY_TEXT_SIZE(dx, dy) for the whole area).
+ * Returns the text length, truncated to size - 1.
+ */
+size_t format_image_xy(char *buf, size_t size, uint16_t *image, unsigned x0, unsigned y0, unsigned dx, unsigned dy)
+{
+    size_t len = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+    for (unsigned y = 0; y < dy; y++) {
+        for (unsigned x = 0; x < dx && len < size - 1; x++) {
+            len += snprintf(buf + len, size - len, "%04x ", get_pixel_xy(image, x0+x, y0+y));
+        }
+        if (len < size - 1) {
+            buf[len++] = '\n';
+            buf[len] = '\0';
+        }
+    }
+    return len < size ? len : size - 1;
+}
+
+void print_image_xy(uint16_t *image, unsigned x0, unsigned y0, unsigned dx, unsigned dy)
+{
+    char line[IMAGE_XY_TEXT_SIZE(IMAGE_WIDTH, 1)];
+
+    if (dx > IMAGE_WIDTH) {
+        dx = IMAGE_WIDTH;
+    }
+    for (unsigned y = 0; y < dy; y++) {
+        format_image_xy(line, sizeof(line), image, x0, y0 + y, dx, 1);
+        fputs(line, stdout);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Store path of image_fill() */
+typedef enum image_fill_path {
+    IMAGE_FILL_UNCACHED,        /* 32-bit I/O stores, bypassing the data cache */
+    IMAGE_FILL_CACHED,          /* cached stores, then alt_dcache_flush() */
+} image_fill_path;
+
+/* Path used by clear_image_buffer(). Uncached by default as it leaves the
+ * data cache alone; which path is faster on the board has not been measured
+ * (see the image_fill_* benchmarks). */
+#ifndef IMAGE_FILL_PATH
+#define IMAGE_FILL_PATH IMAGE_FILL_UNCACHED
+#endif
+
+bool compare_image_to_default(uint16_t *image, uint16_t default_value);
+void clear_image_buffer(uint16_t *addr, uint16_t fill);
+void image_fill(uint16_t *addr, size_t size, uint16_t fill, image_fill_path path);
+/* Text size of format_image_xy(): "xxxx " per pixel, '\n' per row, '\0' */
+#define IMAGE_XY_TEXT_SIZE(dx, dy) ((5 * (dx) + 1) * (dy) + 1)
+
+uint16_t get_pixel_xy(uint16_t *image, unsigned x, unsigned y);
+size_t format_image_xy(char *buf, size_t size, uint16_t *image, unsigned x0, unsigned y0, unsigned dx, unsigned dy);
+void print_image_xy(uint16_t *image, unsigned x0, unsigned y0, unsigned dx, unsigned dy);
+
+#endif /* IMAGE_H */
@@ -0,0 +1,90 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <io.h>
+#include <system.h>
+#include "image_compare.h"
+
+/* Frame comparison
+ *
+ * Compares a frame buffer against a fill value, e.g. to find out whether
+ * the camera wrote a buffer cleared with clear_image_buffer(). Frames are
+ * read two pixels per 32-bit uncached load, the camera writes them behind
+ * the data cache. size is in bytes, addresses must be 32-bit aligned and
+ * a trailing odd pixel is ignored.
+ *  - image_find_diff(): first differing pixel, stops there.
+ *  - image_compare(): first differing pixel and number of changed pixels,
+ *    scans the whole frame.
+ *  - image_sample_diff(): "did anything arrive" check, reading one word per
+ *    data cache line (1/16th of the frame). The word read moves along the
+ *    line from one line to the next, so that all columns get sampled.
+ */
+
+#ifdef ALT_CPU_DCACHE_LINE_SIZE
+#define LINE_SIZE ALT_CPU_DCACHE_LINE_SIZE
+#else
+#define LINE_SIZE 32
+#endif
+
+#define LINE_WORDS (LINE_SIZE / 4)
+
+/* Index of the first differing pixel of the word at off */
+static uint32_t word_diff_index(const uint16_t *image, size_t off, uint16_t value)
+{
+    return off / 2 + (IORD_16DIRECT(image, off) == value);
+}
+
+uint32_t image_find_diff(const uint16_t *image, size_t size, uint16_t value)
+{
+    uint32_t word = (uint32_t) value << 16 | value;
+    size_t end = size & ~(size_t) 3;
+
+    for (size_t off = 0; off < end; off += 4) {
+        if (IORD_32DIRECT(image, off) != word) {
+            return word_diff_index(image, off, value);
+        }
+    }
+    return IMAGE_DIFF_NONE;
+}
+
+/* Returns the number of changed pixels, diff may be NULL */
+uint32_t image_compare(const uint16_t *image, size_t size, uint16_t value, image_diff *diff)
+{
+    uint32_t word = (uint32_t) value << 16 | value;
+    size_t end = size & ~(size_t) 3;
+    uint32_t first = IMAGE_DIFF_NONE;
+    uint32_t changed = 0;
+
+    for (size_t off = 0; off < end; off += 4) {
+        uint32_t x = IORD_32DIRECT(image, off) ^ word;
+
+        if (x != 0) {
+            changed += ((x & 0xffff) != 0) + ((x >> 16) != 0);
+            if (first == IMAGE_DIFF_NONE) {
+                first = word_diff_index(image, off, value);
+            }
+        }
+    }
+
+    if (diff != NULL) {
+        diff->first = first;
+        diff->changed = changed;
+    }
+    return changed;
+}
+
+bool image_sample_diff(const uint16_t *image, size_t size, uint16_t value)
+{
+    uint32_t word = (uint32_t) value << 16 | value;
+    size_t lines = size / LINE_SIZE;
+
+    for (size_t line = 0; line < lines; line++) {
+        size_t off = line * LINE_SIZE + 4 * (line % LINE_WORDS);
+
+        if (IORD_32DIRECT(image, off) != word) {
+            return true;
+        }
+    }
+    return false;
+}
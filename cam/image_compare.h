@@ -0,0 +1,20 @@
+#ifndef IMAGE_COMPARE_H
+#define IMAGE_COMPARE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Pixel index returned when no pixel differs */
+#define IMAGE_DIFF_NONE UINT32_MAX
+
+typedef struct image_diff {
+    uint32_t first;             /* pixel index of the first difference, or IMAGE_DIFF_NONE */
+    uint32_t changed;           /* number of differing pixels */
+} image_diff;
+
+uint32_t image_find_diff(const uint16_t *image, size_t size, uint16_t value);
+uint32_t image_compare(const uint16_t *image, size_t size, uint16_t value, image_diff *diff);
+bool image_sample_diff(const uint16_t *image, size_t size, uint16_t value);
+
+#endif /* IMAGE_COMPARE_H */
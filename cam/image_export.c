@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <io.h>
+#include <sys/alt_alarm.h>
+#include "camera.h"
+#include "image_export.h"
+#include "rgb888.h"
+#include "timestamp.h"
+
+/* Number of image rows converted into the staging buffer per fwrite() call.
+ * Every stdio call on hostfs is a semihosting trap, so rows are batched. */
+#define EXPORT_ROWS_PER_WRITE   8
+
+#define RGB888_ROW_SIZE     (3*IMAGE_WIDTH)
+#define RGB565_ROW_SIZE     (2*IMAGE_WIDTH)
+
+/* PPM header comment, fixed width so that it can be rewritten in place */
+#define PPM_CHECKSUM_COMMENT "# crc32 %08lx murmur3 %08lx\n"
+
+static uint8_t _staging[EXPORT_ROWS_PER_WRITE * RGB888_ROW_SIZE];
+
+/* Converts row lin of the frame to IMAGE_WIDTH RGB888 pixels, adding the
+ * pixels to sum unless it is NULL.
+ */
+void export_row_rgb888(const uint16_t *image, unsigned lin, uint8_t *dst, checksum_state *sum)
+{
+    rgb888_row(image + IMAGE_WIDTH * lin, IMAGE_WIDTH, dst, sum);
+}
+
+static void rgb565_row_copy(const uint16_t *image, unsigned lin, uint8_t *dst, checksum_state *sum)
+{
+    for (unsigned col = 0; col < IMAGE_WIDTH; col += 2) {
+        uint32_t w = IORD_32DIRECT(image, 2*(IMAGE_WIDTH * lin + col));
+        if (sum != NULL) {
+            checksum_add_pixels(sum, w & 0xffff, w >> 16);
+        }
+        *dst++ = w;
+        *dst++ = w >> 8;
+        *dst++ = w >> 16;
+        *dst++ = w >> 24;
+    }
+}
+
+/* Writes the PPM header with a checksum comment line, its values filled in
+ * by ppm_patch_checksum() once the pixels are written.
+ * Returns the file offset of the comment, or -1 on error.
+ */
+static long ppm_header(FILE *outf, const char *magic, export_stats *stats)
+{
+    long pos;
+    int n;
+
+    n = fprintf(outf, "%s\n", magic);
+    if (n < 0 || (pos = ftell(outf)) < 0) {
+        return -1;
+    }
+    stats->bytes += n;
+    stats->writes++;
+
+    n = fprintf(outf, PPM_CHECKSUM_COMMENT "%d %d\n255\n", 0UL, 0UL, IMAGE_WIDTH, IMAGE_HEIGHT);
+    if (n < 0) {
+        return -1;
+    }
+    stats->bytes += n;
+    stats->writes++;
+    return pos;
+}
+
+static bool ppm_patch_checksum(FILE *outf, long pos, const frame_checksum *sum, export_stats *stats)
+{
+    if (fseek(outf, pos, SEEK_SET) != 0) {
+        return false;
+    }
+    if (fprintf(outf, PPM_CHECKSUM_COMMENT, (unsigned long) sum->crc32, (unsigned long) sum->murmur3) < 0) {
+        return false;
+    }
+    stats->writes++;
+    return true;
+}
+
+/* Writes the frame pixels as ASCII PPM, one fprintf() per pixel.
+ * @note kept as reference to compare against the binary exporters. */
+static bool export_p3(FILE *outf, const uint16_t *image, export_stats *stats, checksum_state *sum)
+{
+    int n;
+    uint16_t prev = 0;
+
+    for (unsigned lin = 0; lin < IMAGE_HEIGHT; lin++) {
+        for (unsigned col = 0; col < IMAGE_WIDTH; col++) {
+            uint16_t pixel = IORD_16DIRECT(image, 2*(IMAGE_WIDTH * lin + col));
+            if (col % 2) {
+                checksum_add_pixels(sum, prev, pixel);
+            }
+            prev = pixel;
+            uint32_t rgb = rgb888_pixel(pixel);
+            n = fprintf(outf, "%hhu %hhu %hhu  ",
+                        (uint8_t) (rgb >> 16), (uint8_t) (rgb >> 8), (uint8_t) rgb);
+            if (n < 0) {
+                return false;
+            }
+            stats->bytes += n;
+            stats->writes++;
+        }
+        if (fprintf(outf, "\n") < 0) {
+            return false;
+        }
+        stats->bytes++;
+        stats->writes++;
+    }
+    return true;
+}
+
+/* Writes the frame in blocks of EXPORT_ROWS_PER_WRITE rows, converted by
+ * row_conv into row_size bytes per row and added to sum. */
+static bool export_rows(FILE *outf, const uint16_t *image, export_stats *stats, checksum_state *sum,
+                        void (*row_conv)(const uint16_t *, unsigned, uint8_t *, checksum_state *),
+                        unsigned row_size)
+{
+    for (unsigned lin = 0; lin < IMAGE_HEIGHT; lin += EXPORT_ROWS_PER_WRITE) {
+        unsigned rows = IMAGE_HEIGHT - lin;
+        if (rows > EXPORT_ROWS_PER_WRITE) {
+            rows = EXPORT_ROWS_PER_WRITE;
+        }
+
+        for (unsigned i = 0; i < rows; i++) {
+            row_conv(image, lin + i, &_staging[i * row_size], sum);
+        }
+
+        size_t len = rows * row_size;
+        if (fwrite(_staging, 1, len, outf) != len) {
+            return false;
+        }
+        stats->bytes += len;
+        stats->writes++;
+    }
+    return true;
+}
+
+/* Export a frame to a file (typically on hostfs: "/mnt/host/...").
+ * Statistics are accumulated into stats, which can be NULL.
+ * The EXPORT_CHECKSUMS of the frame pixels, computed while they are
+ * converted, are stored into checksum unless it is NULL and into the
+ * header of the PPM formats as a "# crc32 <hex> murmur3 <hex>" comment.
+ */
+bool export_image(const uint16_t *image, const char *filename, export_format fmt,
+                  export_stats *stats, frame_checksum *checksum)
+{
+    export_stats local = {0};
+    checksum_state state;
+    frame_checksum sum;
+    long pos = -1;
+    bool ok;
+
+    FILE *outf = fopen(filename, "wb");
+    if (!outf) {
+        printf("Error: could not open \"%s\" for writing\n", filename);
+        return false;
+    }
+
+    timestamp_sync();
+    uint32_t start = alt_nticks();
+    checksum_init(&state, EXPORT_CHECKSUMS);
+    rgb888_init();
+
+    switch (fmt) {
+    case EXPORT_FORMAT_PPM_P3:
+        pos = ppm_header(outf, "P3", &local);
+        ok = pos >= 0 && export_p3(outf, image, &local, &state);
+        break;
+
+    case EXPORT_FORMAT_PPM_P6:
+        pos = ppm_header(outf, "P6", &local);
+        ok = pos >= 0 && export_rows(outf, image, &local, &state, export_row_rgb888, RGB888_ROW_SIZE);
+        break;
+
+    case EXPORT_FORMAT_RAW_RGB565:
+        ok = export_rows(outf, image, &local, &state, rgb565_row_copy, RGB565_ROW_SIZE);
+        break;
+
+    default:
+        ok = false;
+        break;
+    }
+
+    checksum_final(&state, &sum);
+    if (ok && pos >= 0) {
+        ok = ppm_patch_checksum(outf, pos, &sum, &local);
+    }
+
+    if (fclose(outf) != 0) {
+        ok = false;
+    }
+
+    if (!ok) {
+        printf("Error: failed to write \"%s\"\n", filename);
+        return false;
+    }
+
+    if (checksum != NULL) {
+        *checksum = sum;
+    }
+    if (stats != NULL) {
+        stats->frames++;
+        stats->bytes += local.bytes;
+        stats->writes += local.writes;
+        timestamp_sync();
+        stats->ticks += alt_nticks() - start;
+    }
+    return true;
+}
+
+void export_print_stats(const char *name, const export_stats *stats)
+{
+    printf("%s: %lu frames, %lu bytes, %lu writes",
+           name,
+           (unsigned long) stats->frames,
+           (unsigned long) stats->bytes,
+           (unsigned long) stats->writes);
+
+    uint32_t tps = alt_ticks_per_second();
+    if (stats->ticks == 0 || tps == 0) {
+        /* ALT_SYS_CLK none: no time base to compute rates */
+        printf(", rate n/a\n");
+        return;
+    }
+
+    uint64_t ms = (uint64_t) stats->ticks * 1000 / tps;
+    printf(", %lu ms, %lu bytes/s, %lu.%03lu frames/s\n",
+           (unsigned long) ms,
+           (unsigned long) ((uint64_t) stats->bytes * tps / stats->ticks),
+           (unsigned long) ((uint64_t) stats->frames * tps / stats->ticks),
+           (unsigned long) ((uint64_t) stats->frames * tps * 1000 / stats->ticks % 1000));
+}
@@ -0,0 +1,34 @@
+#ifndef IMAGE_EXPORT_H
+#define IMAGE_EXPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "checksum.h"
+
+/* Output file formats */
+typedef enum {
+    EXPORT_FORMAT_PPM_P3,       /* ASCII PPM, one fprintf per pixel (legacy) */
+    EXPORT_FORMAT_PPM_P6,       /* binary PPM, RGB888 */
+    EXPORT_FORMAT_RAW_RGB565,   /* raw frame buffer, little endian RGB565 */
+} export_format;
+
+/* Checksums computed by export_image(), CHECKSUM_* */
+#ifndef EXPORT_CHECKSUMS
+#define EXPORT_CHECKSUMS CHECKSUM_ALL
+#endif
+
+/* Accumulated export statistics, zero initialise before first use */
+typedef struct export_stats {
+    uint32_t frames;    /* number of exported frames */
+    uint32_t bytes;     /* number of bytes written to the file */
+    uint32_t writes;    /* number of stdio calls issued */
+    uint32_t ticks;     /* elapsed system clock ticks */
+} export_stats;
+
+bool export_image(const uint16_t *image, const char *filename, export_format fmt,
+                  export_stats *stats, frame_checksum *checksum);
+void export_print_stats(const char *name, const export_stats *stats);
+void export_row_rgb888(const uint16_t *image, unsigned lin, uint8_t *dst, checksum_state *sum);
+
+#endif /* IMAGE_EXPORT_H */
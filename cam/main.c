@@ -8,150 +8,302 @@
 
 #include <io.h>
 #include <system.h>
+#include <sys/alt_irq.h>
 #include "i2c/i2c.h"
+#include "i2c/i2c_queue.h"
 #include "camera.h"
+#include "image.h"
+#include "image_export.h"
+#include "downscale.h"
+#include "test_pattern.h"
+#include "event_log.h"
+#include "cycles.h"
+#include "timestamp.h"
+#include "bench.h"
 
 /* I2C defines */
 #define I2C_FREQ    (50000000) /* Clock frequency driving the i2c core: 50 MHz in this example (ADAPT TO YOUR DESIGN) */
 #define I2C_BASE    I2C_0_BASE
 
+/* I2C interrupt. The BSP gives -1 and, unlike CAM_IRQ in camera.c, the Qsys
+ * number of the i2c core interrupt is not known for this design: as shipped
+ * the asynchronous transfers are polled, one byte step per i2c_queue_poll()
+ * from the main loop. The I2C_IRQ >= 0 path has not been run on hardware. */
+#define I2C_IC_ID   0
+#define I2C_IRQ     I2C_0_IRQ
+
 #define TEST 0
 
+/* EXPERIMENTAL: compare every frame against the expected test pattern. The
+ * model of the sensor patterns (see test_pattern.c) has not been checked
+ * against a hardware capture, mismatches may be model errors. */
+#define VERIFY_TEST_PATTERN 0
+
+/* Preview of every frame on stdout as hex text (see send_preview()),
+ * downscaled by 1 << PREVIEW_SHIFT: 0 off, 1 160x120, 2 80x60 (see
+ * downscale.c) */
+#define PREVIEW_SHIFT 0
+
+/* Export the first frame and then every DUMP_PERIOD-th one to DUMP_FILE as
+ * binary PPM, with its checksums in the header (see image_export.c); 0 never.
+ * Each export stalls the capture loop for the hostfs transfer. */
+#define DUMP_PERIOD 256
+#ifndef DUMP_FILE
+#define DUMP_FILE "/mnt/host/image.ppm"
+#endif
+
+/* Run the frame pipeline benchmarks (see bench.c) instead of the capture loop */
+#define BENCH 0
+
 #define IMAGE_ADDR HPS_0_BRIDGES_BASE
 #define IMAGE1 IMAGE_ADDR
 #define IMAGE2 (IMAGE1 + IMAGE_SIZE)
 #define IMAGE3 (IMAGE2 + IMAGE_SIZE)
 
-void delay(uint64_t n)
-{
-    while (n-- > 0) {
-        asm volatile ("nop");
-    }
-}
+/* Camera reset pulse and power up wait */
+#define CAMERA_RESET_US 100000
 
-bool dump_image(const uint16_t *addr)
-{
-    const char* filename = "/mnt/host/image.ppm";
-    FILE *outf = fopen(filename, "w");
-
-    if (!outf) {
-        printf("Error: could not open \"%s\" for writing\n", filename);
-        return false;
-    }
+export_stats dump_stats;
 
-    // PPM header
-    fprintf(outf, "P3\n320 240\n255\n");
-
-    for (unsigned lin = 0; lin < 240; lin++) {
-        printf(".");
-        for (unsigned col = 0; col < 320; col++) {
-            uint16_t pixel = IORD_16DIRECT(addr, 2*(320 * lin + col));
-            uint8_t r = (uint8_t)((pixel >> 11) & 0b11111)<<3;
-            uint8_t g = (uint8_t)((pixel >> 5) & 0b111111)<<2;
-            uint8_t b = (uint8_t)(pixel & 0b11111)<<3;
-            fprintf(outf, "%hhu %hhu %hhu  ", r, g, b);
-        }
-        fprintf(outf, "\n");
-    }
-    printf("\n");
-    fclose(outf);
-    return true;
-}
+#if PREVIEW_SHIFT
+#if PREVIEW_SHIFT > DOWNSCALE_MAX_SHIFT
+#error "PREVIEW_SHIFT must be 0, 1 or 2"
+#endif
 
-#define IMAGE_DEFAULT_VAL 0xdead
+uint16_t preview[DOWNSCALE_SIZE(PREVIEW_SHIFT) / 2];
 
-bool compare_image_to_default(uint16_t *image, uint16_t default_value)
+/* Writes a "PREVIEW <seq> <width> <height>" line followed by <height> lines
+ * of <width> RGB565 pixels as 4 hex digits each, so that the preview stays
+ * text and can be told apart from the log lines on the JTAG UART */
+void send_preview(const camera_frame *frame)
 {
-    /* compare image buffer */
-    for (unsigned i = 0; i < IMAGE_SIZE/2; i++) {
-        uint16_t pix = IORD_16DIRECT(image, 2*i);
-        if (pix != default_value) {
-            printf("difference found at image[%u] = %x\n", i, pix);
-            return true;
+    static const char hex[] = "0123456789abcdef";
+    char line[4 * DOWNSCALE_WIDTH(PREVIEW_SHIFT) + 2];
+
+    downscale(frame->buf, PREVIEW_SHIFT, preview);
+    printf("PREVIEW %lu %u %u\n", (unsigned long) frame->seq,
+           DOWNSCALE_WIDTH(PREVIEW_SHIFT), DOWNSCALE_HEIGHT(PREVIEW_SHIFT));
+    for (unsigned y = 0; y < DOWNSCALE_HEIGHT(PREVIEW_SHIFT); y++) {
+        const uint16_t *row = &preview[y * DOWNSCALE_WIDTH(PREVIEW_SHIFT)];
+        char *p = line;
+
+        for (unsigned x = 0; x < DOWNSCALE_WIDTH(PREVIEW_SHIFT); x++) {
+            *p++ = hex[row[x] >> 12];
+            *p++ = hex[(row[x] >> 8) & 0xf];
+            *p++ = hex[(row[x] >> 4) & 0xf];
+            *p++ = hex[row[x] & 0xf];
         }
+        *p++ = '\n';
+        *p = '\0';
+        fputs(line, stdout);
     }
-    return false;
+    fflush(stdout);
 }
+#endif
 
-void clear_image_buffer(uint16_t *addr, uint16_t fill)
+bool dump_image(camera_frame *frame)
 {
-    for (unsigned i = 0; i < IMAGE_SIZE/2; i++) {
-        IOWR_16DIRECT(addr, 2*i, fill);
+    if (!export_image(frame->buf, DUMP_FILE, EXPORT_FORMAT_PPM_P6, &dump_stats, &frame->checksum)) {
+        return false;
     }
+    export_print_stats("dump_image", &dump_stats);
+    printf("dump_image: frame %lu crc32 %08lx murmur3 %08lx\n",
+           (unsigned long) frame->seq,
+           (unsigned long) frame->checksum.crc32,
+           (unsigned long) frame->checksum.murmur3);
+    return true;
 }
 
-uint16_t get_pixel_xy(uint16_t *image, unsigned x, unsigned y)
-{
-    return IORD_16DIRECT(image, 2*(x + IMAGE_WIDTH*y));
-}
+#define IMAGE_DEFAULT_VAL 0xdead
 
-void print_image_xy(uint16_t *image, unsigned x0, unsigned y0, unsigned dx, unsigned dy)
+void print_i2c_stats(const char *name, const i2c_dev *i2c)
 {
-    for (unsigned y = 0; y < dy; y++) {
-        for (unsigned x = 0; x < dx; x++) {
-            printf("%04x ", get_pixel_xy(image, x0+x, y0+y));
-        }
+    const i2c_stats *st = &i2c->stats;
+
+    printf("%s: %lu Hz, %lu transactions, %lu errors, %lu timeouts, %lu bytes",
+           name,
+           (unsigned long) i2c->bus_speed,
+           (unsigned long) st->transactions,
+           (unsigned long) st->errors,
+           (unsigned long) st->timeouts,
+           (unsigned long) st->bytes);
+
+    if (i2c->timestamp == NULL || st->transactions == 0) {
         printf("\n");
+        return;
     }
+
+    uint32_t mean = st->time_total / st->transactions;
+    printf(", mean %lu cycles (%lu us), max %lu cycles (%lu us)\n",
+           (unsigned long) mean,
+           (unsigned long) ((uint64_t) mean * 1000000 / cycles_freq()),
+           (unsigned long) st->time_max,
+           (unsigned long) ((uint64_t) st->time_max * 1000000 / cycles_freq()));
 }
 
-uint16_t *next_image = NULL;
-uint16_t *last_image = NULL;
-volatile bool image_received = false;
 void camera_interrupt(void *arg)
 {
     (void) arg;
-    camera_disable_receive();
+    timestamp_sync();
+    camera_queue_irq();
+
+    event_log_push("camera interrupt: %lu received, %lu dropped\n",
+                   camera_queue_received(), camera_queue_dropped());
+}
+
+i2c_queue i2c_queue_0;
 
-    last_image = camera_get_frame_buffer();
-    camera_set_frame_buffer(next_image);
-    image_received = true;
-    camera_clear_irq_flag();
+/* Background work, also run while waiting on synchronous i2c transfers */
+static void main_background(void *arg)
+{
+    (void) arg;
+    timestamp_sync();
+    event_log_drain();
+}
 
-    printf("\nCAMERA INTERRUPT\n");
+#if I2C_IRQ >= 0
+void i2c_interrupt(void *arg)
+{
+    i2c_handle_irq((i2c_dev *) arg);
 }
+#endif
 
 int main(void)
 {
+    bool have_cycles = cycles_init();
+
+    if (have_cycles) {
+        camera_set_timestamp_source(cycles_now);
+        event_log_set_timestamp_source(cycles_now);
+        timestamp_init(TIMESTAMP_TICKS_PER_SECOND);
+    } else {
+        printf("No cycle counter or timestamp timer, frame timestamps and timing statistics disabled\n");
+    }
+
     printf("I2C init\n");
     i2c_dev i2c = i2c_inst((void *) I2C_BASE);
-    i2c_init(&i2c, I2C_FREQ);
+    if (i2c_init_speed(&i2c, I2C_FREQ, I2C_SPEED_FAST) != I2C_SUCCESS) {
+        printf("Error: invalid I2C bus speed, falling back to standard mode\n");
+        if (i2c_init(&i2c, I2C_FREQ) != I2C_SUCCESS) {
+            printf("Error: I2C clock divisor out of range\n");
+            return 1;
+        }
+    }
+    if (have_cycles) {
+        i2c_set_timestamp(&i2c, cycles_now, cycles_freq());
+    }
+#if I2C_IRQ >= 0
+    alt_ic_isr_register(I2C_IC_ID, I2C_IRQ, i2c_interrupt, &i2c, NULL);
+    alt_ic_irq_enable(I2C_IC_ID, I2C_IRQ);
+#endif
+    i2c_queue_init(&i2c_queue_0, &i2c);
+    i2c_queue_set_wait(&i2c_queue_0, main_background, NULL);
+    camera_set_i2c_queue(&i2c_queue_0);
 
-    uint16_t *image1 = (uint16_t *)IMAGE1;
-    uint16_t *image2 = (uint16_t *)IMAGE2;
+    uint16_t *const frames[] = {
+        (uint16_t *)IMAGE1,
+        (uint16_t *)IMAGE2,
+        (uint16_t *)IMAGE3,
+    };
+    const unsigned nb_frames = sizeof(frames) / sizeof(frames[0]);
 
     /* Point somewhere else during camera setup */
-    camera_set_frame_buffer(image1);
+    camera_set_frame_buffer(frames[0]);
     camera_disable_receive();
 
     /* Camera reset cycle */
     printf("Camera reset\n");
     camera_disable();
-    delay(1000000);
+    timestamp_delay_us(CAMERA_RESET_US);
     camera_enable();
-    delay(1000000);
+    timestamp_delay_us(CAMERA_RESET_US);
 
 
     printf("Camera setup\n");
-    camera_setup(&i2c, image1, camera_interrupt, NULL);
+    for (unsigned i = 0; i < nb_frames; i++) {
+        clear_image_buffer(frames[i], IMAGE_DEFAULT_VAL);
+    }
+    if (!camera_queue_init(frames, nb_frames) || !camera_queue_set_mode(CAMERA_QUEUE_CONTINUOUS)) {
+        printf("Error: too few frame buffers for the queue\n");
+        return 1;
+    }
+    camera_queue_set_integrity(CAMERA_INTEGRITY_CANARY);
+    int status = camera_setup(&i2c, frames[0], camera_interrupt, NULL);
+    print_i2c_stats("I2C camera setup", &i2c);
+    if (status != I2C_SUCCESS) {
+        printf("Error: camera setup failed (I2C error %d), not streaming\n", status);
+        return 1;
+    }
+    i2c_reset_stats(&i2c);
 
-    camera_dump_regs();
+    status = camera_dump_regs();
+    print_i2c_stats("I2C register dump", &i2c);
+    if (status != I2C_SUCCESS) {
+        printf("Error: camera register dump failed (I2C error %d), not streaming\n", status);
+        return 1;
+    }
+    if (camera_verify_regs() != 0) {
+        printf("Warning: camera registers differ from shadow copy\n");
+    }
 
-    while (1) {
-        clear_image_buffer(image1, IMAGE_DEFAULT_VAL);
+#if BENCH
+    bench_run(frames[0], &i2c);
+    return 0;
+#endif
+
+    camera_enable_receive();
 
-        next_image = image1;
-        camera_enable_receive();
+    while (1) {
+        camera_frame *frame;
 
         /* Wait until done*/
         printf("Camera wait for image... ");
-        while(!image_received);
-        image_received = false;
-        printf("DONE\n");
+        while ((frame = camera_queue_get()) == NULL) {
+            main_background(NULL);
+            /* drives the queued i2c transfers (no i2c interrupt) */
+            i2c_queue_poll(&i2c_queue_0);
+        }
+        event_log_drain();
+        printf("DONE frame %lu (%lu dropped, %lu total)\n",
+               (unsigned long) frame->seq,
+               (unsigned long) frame->dropped,
+               (unsigned long) camera_queue_dropped());
 
-        compare_image_to_default(last_image, IMAGE_DEFAULT_VAL);
+        uint16_t *image = frame->buf;
+
+        if (frame->canaries != 0) {
+            printf("Warning: frame %lu incomplete, %u canaries not overwritten\n",
+                   (unsigned long) frame->seq, frame->canaries);
+        }
+
+#if VERIFY_TEST_PATTERN
+        if (camera_get_config()->test_pattern) {
+            test_pattern_result res;
+            if (!test_pattern_verify(image, camera_get_config(), &res)) {
+                printf("frame %lu: ", (unsigned long) frame->seq);
+                test_pattern_print(&res);
+            }
+        }
+#endif
+
+        i2c_queue_poll(&i2c_queue_0);
+
+#if PREVIEW_SHIFT
+        send_preview(frame);
+        i2c_queue_poll(&i2c_queue_0);
+#endif
 
         /* debug info */
-        print_image_xy(image1, 0, 0, 32, 2);
+        print_image_xy(image, 0, 0, 32, 2);
+        if (frame->seq % 64 == 63) {
+            camera_stats_dump();
+        }
+#if DUMP_PERIOD
+        if (frame->seq % DUMP_PERIOD == 0) {
+            dump_image(frame);
+        }
+#endif
+
+        camera_queue_release();
     }
 }
@@ -0,0 +1,71 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <io.h>
+#include "checksum.h"
+#include "rgb888.h"
+
+/* RGB565 to RGB888 conversion
+ *
+ * Components are widened with bit replication, so that the full 8-bit
+ * range is used (0x1f gives 0xff, not 0xf8):
+ *   R8 = R5 << 3 | R5 >> 2, G8 = G6 << 2 | G6 >> 4, B8 = B5 << 3 | B5 >> 2
+ *
+ * Green straddles the two bytes of a pixel (RRRRRGGG GGGBBBBB), but its
+ * replicated bits do not overlap: with G6 = Gh << 3 | Gl,
+ *   G8 = Gh << 5 | Gl << 2 | Gh >> 1
+ * so one table per byte gives the whole pixel with a single OR.
+ */
+
+uint32_t rgb888_hi[256];
+uint32_t rgb888_lo[256];
+static bool _ready;
+
+/* Builds the tables once, done by rgb888_row() on first use. */
+void rgb888_init(void)
+{
+    if (_ready) {
+        return;
+    }
+    for (unsigned i = 0; i < 256; i++) {
+        uint32_t r5 = i >> 3;
+        uint32_t gh = i & 0x7;
+        uint32_t gl = i >> 5;
+        uint32_t b5 = i & 0x1f;
+
+        rgb888_hi[i] = (r5 << 3 | r5 >> 2) << 16 | (gh << 5 | gh >> 1) << 8;
+        rgb888_lo[i] = (gl << 2) << 8 | (b5 << 3 | b5 >> 2);
+    }
+    _ready = true;
+}
+
+static inline uint8_t *put_rgb888(uint8_t *dst, uint32_t rgb)
+{
+    dst[0] = rgb >> 16;
+    dst[1] = rgb >> 8;
+    dst[2] = rgb;
+    return dst + 3;
+}
+
+/* Converts pixels (an even number) of the frame buffer at src to RGB888,
+ * two pixels per 32-bit uncached load, adding them to sum unless it is
+ * NULL. src must be 32-bit aligned.
+ */
+void rgb888_row(const uint16_t *src, unsigned pixels, uint8_t *dst, checksum_state *sum)
+{
+    if (!_ready) {
+        rgb888_init();
+    }
+
+    for (unsigned i = 0; i < pixels / 2; i++) {
+        uint32_t w = IORD_32DIRECT(src, 4 * i);
+        uint16_t p0 = w & 0xffff;
+        uint16_t p1 = w >> 16;
+
+        if (sum != NULL) {
+            checksum_add_pixels(sum, p0, p1);
+        }
+        dst = put_rgb888(dst, rgb888_pixel(p0));
+        dst = put_rgb888(dst, rgb888_pixel(p1));
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef RGB888_H
+#define RGB888_H
+
+#include <stdint.h>
+
+#include "checksum.h"
+
+/* RGB565 to RGB888 lookup tables, indexed by the high and low byte of a
+ * pixel: rgb888_hi[p >> 8] | rgb888_lo[p & 0xff] is 0x00RRGGBB.
+ */
+extern uint32_t rgb888_hi[256];
+extern uint32_t rgb888_lo[256];
+
+void rgb888_init(void);
+void rgb888_row(const uint16_t *src, unsigned pixels, uint8_t *dst, checksum_state *sum);
+
+/* Returns pixel as 0x00RRGGBB.
+ * @note rgb888_init() must have been called before.
+ */
+static inline uint32_t rgb888_pixel(uint16_t pixel)
+{
+    return rgb888_hi[pixel >> 8] | rgb888_lo[pixel & 0xff];
+}
+
+#endif /* RGB888_H */
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <io.h>
+#include "camera.h"
+#include "image_compare.h"
+#include "test_pattern.h"
+
+/* Test pattern generator and verifier
+ *
+ * Synthesizes the RGB565 frame expected for the sensor test patterns of a
+ * camera_config, and compares received frames against it: the automated
+ * link and timing test at production pixel clock rates.
+ *
+ * Model of the TRDB-D5M patterns as seen through the camera controller
+ * (each output pixel is a 2x2 Bayer quad, 12-bit components truncated to
+ * RGB565):
+ *  - bar widths are test_pattern_bar_width + 1 sensor rows or columns, an
+ *    output pixel covers 2 of them, 8 with binning (4x bin and skip);
+ *  - gradients span the output frame and are computed from output pixel
+ *    coordinates, whereas the sensor most likely ramps over its own column
+ *    and row addresses (so windowing and binning would change them);
+ *  - colour bars are IMAGE_WIDTH / 8 output pixels wide;
+ *  - TEST_PATTERN_MARCHING_1S moves by one bit per frame, its phase is
+ *    found from the first row of the frame;
+ *  - mirroring flips the output frame.
+ * EXPERIMENTAL: it is a guess from the register descriptions and has NOT
+ * been checked against frames from a real sensor, so on hardware a mismatch
+ * may be a model error rather than a link error. The host simulator
+ * implements the patterns separately and sim_setup checks both against
+ * hand-computed reference pixels, but those follow the same guess: the
+ * checks show that the code implements the model, not that the model
+ * matches the MT9P001.
+ *
+ * The verifier reads the frame two pixels per 32-bit load and compares
+ * against an expected row generated in memory, only regenerated when the
+ * pattern changes from one row to the next.
+ */
+
+/* 12-bit sensor components to RGB565 */
+#define RGB565(r, g, b) ((uint16_t) ((((r) >> 7) << 11) | (((g) >> 6) << 5) | ((b) >> 7)))
+
+#define GRAY(v) RGB565((v), (v), (v))
+
+/* White, yellow, cyan, green, magenta, red, blue, black */
+static const uint16_t _color_bars[8] = {
+    RGB565(0xfff, 0xfff, 0xfff), RGB565(0xfff, 0xfff, 0x000),
+    RGB565(0x000, 0xfff, 0xfff), RGB565(0x000, 0xfff, 0x000),
+    RGB565(0xfff, 0x000, 0xfff), RGB565(0xfff, 0x000, 0x000),
+    RGB565(0x000, 0x000, 0xfff), RGB565(0x000, 0x000, 0x000),
+};
+
+/* Expected row, as pixels and as the 32-bit words read from the frame
+ * (little endian: first pixel in the low half) */
+static uint16_t _expected[IMAGE_WIDTH];
+static uint32_t _expected_words[IMAGE_WIDTH / 2];
+
+/* Sensor rows or columns per output pixel */
+static unsigned sensor_lines(const camera_config *cfg)
+{
+    return cfg->binning ? 8 : 2;
+}
+
+/* Pixel (x, y) of the unmirrored pattern */
+uint16_t test_pattern_pixel(const camera_config *cfg, unsigned phase, unsigned x, unsigned y)
+{
+    uint16_t color = RGB565(cfg->test_pattern_red & 0xfff,
+                            cfg->test_pattern_green & 0xfff,
+                            cfg->test_pattern_blue & 0xfff);
+    unsigned width = cfg->test_pattern_bar_width + 1;
+
+    switch (cfg->test_pattern_type) {
+    case TEST_PATTERN_COLOR_FIELD:
+        return color;
+    case TEST_PATTERN_HORIZONTAL_GRADIENT:
+        return GRAY(x * 0xfff / (IMAGE_WIDTH - 1));
+    case TEST_PATTERN_VERTICAL_GRADIENT:
+        return GRAY(y * 0xfff / (IMAGE_HEIGHT - 1));
+    case TEST_PATTERN_DIAGONAL:
+        return GRAY((x + y) * 0xfff / (IMAGE_WIDTH + IMAGE_HEIGHT - 2));
+    case TEST_PATTERN_CLASSIC:
+        /* colour bars over a horizontal gradient */
+        if (y >= IMAGE_HEIGHT / 2) {
+            return GRAY(x * 0xfff / (IMAGE_WIDTH - 1));
+        }
+        return _color_bars[x * 8 / IMAGE_WIDTH];
+    case TEST_PATTERN_MARCHING_1S:
+        return GRAY(1 << ((x + y + phase) % TEST_PATTERN_PHASES));
+    case TEST_PATTERN_MONOCHROME_HORIZONTAL_BARS:
+        return ((y * sensor_lines(cfg) / width) % 2 == 0) ? color : 0;
+    case TEST_PATTERN_MONOCHROME_VERTICAL_BARS:
+        return ((x * sensor_lines(cfg) / width) % 2 == 0) ? color : 0;
+    case TEST_PATTERN_VERTICAL_COLOR_BARS:
+    default:
+        return _color_bars[x * 8 / IMAGE_WIDTH];
+    }
+}
+
+/* Generates row y of the expected frame into row (IMAGE_WIDTH pixels) */
+void test_pattern_row(const camera_config *cfg, unsigned phase, unsigned y, uint16_t *row)
+{
+    unsigned sy = cfg->mirror_row ? IMAGE_HEIGHT - 1 - y : y;
+
+    for (unsigned x = 0; x < IMAGE_WIDTH; x++) {
+        unsigned sx = cfg->mirror_col ? IMAGE_WIDTH - 1 - x : x;
+        row[x] = test_pattern_pixel(cfg, phase, sx, sy);
+    }
+}
+
+/* Generates the expected row y into _expected and _expected_words */
+static void expect_row(const camera_config *cfg, unsigned phase, unsigned y)
+{
+    test_pattern_row(cfg, phase, y, _expected);
+    for (unsigned i = 0; i < IMAGE_WIDTH / 2; i++) {
+        _expected_words[i] = (uint32_t) _expected[2 * i + 1] << 16 | _expected[2 * i];
+    }
+}
+
+/* Writes the expected frame to image */
+void test_pattern_generate(const camera_config *cfg, unsigned phase, uint16_t *image)
+{
+    for (unsigned y = 0; y < IMAGE_HEIGHT; y++) {
+        expect_row(cfg, phase, y);
+        for (unsigned i = 0; i < IMAGE_WIDTH / 2; i++) {
+            IOWR_32DIRECT(image, 2 * y * IMAGE_WIDTH + 4 * i, _expected_words[i]);
+        }
+    }
+}
+
+/* Identifies the rows with the same expected pixels: rows with different
+ * keys differ. */
+static unsigned row_key(const camera_config *cfg, unsigned y)
+{
+    unsigned sy = cfg->mirror_row ? IMAGE_HEIGHT - 1 - y : y;
+
+    switch (cfg->test_pattern_type) {
+    case TEST_PATTERN_COLOR_FIELD:
+    case TEST_PATTERN_HORIZONTAL_GRADIENT:
+    case TEST_PATTERN_MONOCHROME_VERTICAL_BARS:
+    case TEST_PATTERN_VERTICAL_COLOR_BARS:
+        return 0;
+    case TEST_PATTERN_CLASSIC:
+        return sy >= IMAGE_HEIGHT / 2;
+    default:
+        return sy;
+    }
+}
+
+/* Returns true if row y of image is the expected row */
+static bool row_matches(const uint16_t *image, unsigned y)
+{
+    size_t base = 2 * y * IMAGE_WIDTH;
+
+    for (unsigned i = 0; i < IMAGE_WIDTH / 2; i++) {
+        if (IORD_32DIRECT(image, base + 4 * i) != _expected_words[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Returns the marching ones phase matching the first row of image */
+static unsigned find_phase(const uint16_t *image, const camera_config *cfg)
+{
+    if (cfg->test_pattern_type != TEST_PATTERN_MARCHING_1S) {
+        return 0;
+    }
+    for (unsigned phase = 0; phase < TEST_PATTERN_PHASES; phase++) {
+        expect_row(cfg, phase, 0);
+        if (row_matches(image, 0)) {
+            return phase;
+        }
+    }
+    return 0;
+}
+
+/* Compares image against the test pattern of cfg.
+ * Returns true if they match, the mismatches are described in res.
+ * @note cfg must have the test pattern enabled.
+ */
+bool test_pattern_verify(const uint16_t *image, const camera_config *cfg, test_pattern_result *res)
+{
+    unsigned phase = find_phase(image, cfg);
+    unsigned key = 0;
+
+    *res = (test_pattern_result) {.first = IMAGE_DIFF_NONE, .phase = phase};
+
+    for (unsigned y = 0; y < IMAGE_HEIGHT; y++) {
+        unsigned k = row_key(cfg, y);
+
+        if (y == 0 || k != key) {
+            expect_row(cfg, phase, y);
+            key = k;
+        }
+
+        size_t base = 2 * y * IMAGE_WIDTH;
+        for (unsigned i = 0; i < IMAGE_WIDTH / 2; i++) {
+            uint32_t x = IORD_32DIRECT(image, base + 4 * i) ^ _expected_words[i];
+
+            if (x == 0) {
+                continue;
+            }
+            res->mismatches += ((x & 0xffff) != 0) + ((x >> 16) != 0);
+            res->map[y / TEST_PATTERN_TILE] |= 1u << (2 * i / TEST_PATTERN_TILE);
+            if (res->first == IMAGE_DIFF_NONE) {
+                unsigned col = 2 * i + (IORD_16DIRECT(image, base + 4 * i) == _expected[2 * i]);
+                res->first = y * IMAGE_WIDTH + col;
+                res->expected = _expected[col];
+                res->actual = IORD_16DIRECT(image, 2 * res->first);
+            }
+        }
+    }
+    return res->mismatches == 0;
+}
+
+/* Prints the result with the mismatch map, one character per tile */
+void test_pattern_print(const test_pattern_result *res)
+{
+    if (res->mismatches == 0) {
+        printf("test pattern (experimental model): match\n");
+        return;
+    }
+
+    printf("test pattern (experimental model): %lu mismatches, first at (%lu, %lu): %04x, expected %04x\n",
+           (unsigned long) res->mismatches,
+           (unsigned long) (res->first % IMAGE_WIDTH),
+           (unsigned long) (res->first / IMAGE_WIDTH),
+           res->actual, res->expected);
+    for (unsigned row = 0; row < TEST_PATTERN_MAP_ROWS; row++) {
+        for (unsigned col = 0; col < TEST_PATTERN_MAP_COLS; col++) {
+            putchar((res->map[row] >> col) & 1 ? 'X' : '.');
+        }
+        putchar('\n');
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef TEST_PATTERN_H
+#define TEST_PATTERN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "camera.h"
+
+/* EXPERIMENTAL: the expected frames come from a model of the sensor test
+ * patterns that has not been checked against a capture from a real MT9P001,
+ * see test_pattern.c. A mismatch on hardware may be a model error.
+ */
+
+/* Period of TEST_PATTERN_MARCHING_1S, in frames */
+#define TEST_PATTERN_PHASES     12
+
+/* Mismatch map tiles, TEST_PATTERN_TILE x TEST_PATTERN_TILE pixels */
+#define TEST_PATTERN_TILE       16
+#define TEST_PATTERN_MAP_COLS   (IMAGE_WIDTH / TEST_PATTERN_TILE)
+#define TEST_PATTERN_MAP_ROWS   (IMAGE_HEIGHT / TEST_PATTERN_TILE)
+
+typedef struct test_pattern_result {
+    uint32_t mismatches;                    /* differing pixels */
+    uint32_t first;                         /* pixel index of the first one, IMAGE_DIFF_NONE if none */
+    uint16_t expected;                      /* at first */
+    uint16_t actual;
+    unsigned phase;                         /* TEST_PATTERN_MARCHING_1S phase found in the frame */
+    uint32_t map[TEST_PATTERN_MAP_ROWS];    /* bit n of map[i]: tile (n, i) has mismatches */
+} test_pattern_result;
+
+uint16_t test_pattern_pixel(const camera_config *cfg, unsigned phase, unsigned x, unsigned y);
+void test_pattern_row(const camera_config *cfg, unsigned phase, unsigned y, uint16_t *row);
+void test_pattern_generate(const camera_config *cfg, unsigned phase, uint16_t *image);
+bool test_pattern_verify(const uint16_t *image, const camera_config *cfg, test_pattern_result *res);
+void test_pattern_print(const test_pattern_result *res);
+
+#endif /* TEST_PATTERN_H */
@@ -0,0 +1,111 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <system.h>
+#include <sys/alt_alarm.h>
+#include <sys/alt_irq.h>
+#include "cycles.h"
+#include "timestamp.h"
+
+/* Time base for the HAL
+ *
+ * The BSP has neither a timestamp timer nor a system clock timer
+ * (ALT_TIMESTAMP_CLK and ALT_SYS_CLK are none). This driver provides both
+ * from the free-running cycle counter of cycles.c:
+ *  - alt_timestamp_start(), alt_timestamp() and alt_timestamp_freq(), the
+ *    HAL timestamp driver interface, count CPU cycles.
+ *  - the system clock: without a periodic interrupt, timestamp_sync()
+ *    catches alt_nticks() up with the counter, calling alt_tick() once per
+ *    elapsed tick (which also runs the alt_alarm callbacks). Call it from
+ *    the main loop and the frame interrupt, at least every 2^32 cycles.
+ * Each part is left out if the BSP gets a real timer for it.
+ */
+
+static bool _running;
+static uint32_t _timestamp_base;
+static uint32_t _cycles_per_tick;
+static uint32_t _last_tick;
+
+/* Starts the counter based time base, with the system clock at
+ * ticks_per_second. Returns false if there is no cycle counter.
+ */
+bool timestamp_init(uint32_t ticks_per_second)
+{
+    if (!cycles_init()) {
+        return false;
+    }
+    _running = true;
+    _timestamp_base = cycles_now();
+
+#ifndef ALT_SYS_CLK_BASE
+    if (ticks_per_second != 0 && alt_sysclk_init(ticks_per_second) == 0) {
+        _cycles_per_tick = cycles_freq() / ticks_per_second;
+        _last_tick = cycles_now();
+    }
+#else
+    (void) ticks_per_second;
+#endif
+    return true;
+}
+
+/* Advances the system clock to the current time.
+ * @note safe to call from interrupt handlers.
+ */
+void timestamp_sync(void)
+{
+#ifndef ALT_SYS_CLK_BASE
+    if (_cycles_per_tick == 0) {
+        return;
+    }
+
+    alt_irq_context context = alt_irq_disable_all();
+    uint32_t now = cycles_now();
+    while (now - _last_tick >= _cycles_per_tick) {
+        _last_tick += _cycles_per_tick;
+        alt_tick();
+    }
+    alt_irq_enable_all(context);
+#endif
+}
+
+/* Busy waits for us microseconds on the cycle counter, or with the HAL's
+ * calibrated usleep() loop without one.
+ */
+void timestamp_delay_us(uint32_t us)
+{
+    if (!_running) {
+        usleep(us);
+        return;
+    }
+
+    uint32_t start = cycles_now();
+    uint32_t cycles = (uint64_t) us * cycles_freq() / 1000000;
+
+    while (cycles_now() - start < cycles) {
+        timestamp_sync();
+    }
+}
+
+#ifndef ALT_TIMESTAMP_CLK_BASE
+/* Restarts the timestamp from 0. Returns -1 if there is no cycle counter. */
+int alt_timestamp_start(void)
+{
+    if (!_running && !timestamp_init(0)) {
+        return -1;
+    }
+    _timestamp_base = cycles_now();
+    return 0;
+}
+
+/* Cycles since alt_timestamp_start(), wraps after 2^32 cycles. */
+uint32_t alt_timestamp(void)
+{
+    return _running ? cycles_now() - _timestamp_base : 0;
+}
+
+uint32_t alt_timestamp_freq(void)
+{
+    return _running ? cycles_freq() : 0;
+}
+#endif
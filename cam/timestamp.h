@@ -0,0 +1,19 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* System clock rate maintained by timestamp_sync() */
+#define TIMESTAMP_TICKS_PER_SECOND 100
+
+bool timestamp_init(uint32_t ticks_per_second);
+void timestamp_sync(void);
+void timestamp_delay_us(uint32_t us);
+
+/* HAL timestamp driver interface (sys/alt_timestamp.h) */
+int alt_timestamp_start(void);
+uint32_t alt_timestamp(void);
+uint32_t alt_timestamp_freq(void);
+
+#endif /* TIMESTAMP_H */
@@ -0,0 +1,74 @@
+#ifndef TRDB_D5M_REGS_H
+#define TRDB_D5M_REGS_H
+
+/* TRDB_D5M Camera defines */
+#define TRDB_D5M_I2C_ADDRESS  (0xba)
+
+/* Register Map */
+#define REG_CHIP_VERSION                0x000   // default: 0x1801
+#define REG_ROW_START                   0x001   // default: 0x0036 (54)
+#define REG_COLUMN_STAR                 0x002   // default: 0x0010 (16)
+#define REG_ROW_SIZE                    0x003   // default: 0x0797 (1943)
+#define REG_COLUMN_SIZE                 0x004   // default: 0x0A1F (2591)
+#define REG_HORIZONTAL_BLANK            0x005   // default: 0x0000 (0)
+#define REG_VERTICAL_BLANK              0x006   // default: 0x0019 (25)
+#define REG_OUTPUT_CONTROL              0x007   // default: 0x1F82
+#define REG_SHUTTER_WIDTH_UPPER         0x008   // default: 0x0000
+#define REG_SHUTTER_WIDTH_LOWER         0x009   // default: 0x0797
+#define REG_PIXEL_CLOCK_CONTROL         0x00A   // default: 0x0000
+#define REG_RESTART                     0x00B   // default: 0x0000
+#define REG_SHUTTER_DELAY               0x00C   // default: 0x0000
+#define REG_RESET                       0x00D   // default: 0x0000
+#define REG_PLL_CONTROL                 0x010   // default: 0x0050
+#define REG_PLL_CONFIG_1                0x011   // default: 0x6404
+#define REG_PLL_CONFIG_2                0x012   // default: 0x0000
+#define REG_READ_MODE_1                 0x01E   // default: 0x4006
+#define REG_READ_MODE_2                 0x020   // default: 0x0007
+#define REG_ROW_ADDRESS_MODE            0x022   // default: 0x8000
+#define REG_COLUMN_ADDRESS_MODE         0x023   // default: 0x0007
+#define REG_GREEN1_GAIN                 0x02B   // default: 0x0007
+#define REG_BLUE_GAIN                   0x02C   // default: 0x0004
+#define REG_RED_GAIN                    0x02D   // default: 0x0001
+#define REG_GREEN2_GAIN                 0x02E   // default: 0x005A
+#define REG_GLOBAL_GAIN                 0x035   // default: 0x231D
+#define REG_ROW_BLACK_TARGET            0x049   // default: 0xA700
+#define REG_ROW_BLACK_DEFAULT_OFFSET    0x04B   // default: 0x0C00
+#define REG_TEST_PATTERN_CONTROL        0x0A0   // default: 0x0000
+#define REG_TEST_PATTERN_GREEN          0x0A1   // default: 0x0000
+#define REG_TEST_PATTERN_RED            0x0A2   // default: 0x0000
+#define REG_TEST_PATTERN_BLUE           0x0A3   // default: 0x0000
+#define REG_TEST_PATTERN_BAR_WIDTH      0x0A4   // default: 0x0000
+#define REG_CHIP_VERSION_ALT            0x0FF   // default: 0x1801
+
+/* Bit position and mask defines */
+/* REG_ROW_ADDRESS_MODE */
+#define ROW_BIN_POS         4
+#define ROW_SKIP_POS        0
+/* REG_COLUMN_ADDRESS_MODE */
+#define COL_BIN_POS         4
+#define COL_SKIP_POS        0
+/* REG_OUTPUT_CONTROL */
+#define CHIP_ENABLE_MASK    (1<<1)
+/* REG_READ_MODE_1 */
+#define SNAPSHOT_MASK       (1<<8)
+/* REG_READ_MODE_2 */
+#define MIRROR_ROW_MASK     (1<<15)
+#define MIRROR_COL_MASK     (1<<14)
+/* REG_PIXEL_CLOCK_CONTROL */
+#define INVERT_PIXCLK_MASK  (1<<15)
+#define DIVIDE_PIXCLK_POS   0
+/* REG_TEST_PATTERN_CONTROL */
+#define TEST_PATTERN_COLOR_FIELD 0
+#define TEST_PATTERN_HORIZONTAL_GRADIENT 1
+#define TEST_PATTERN_VERTICAL_GRADIENT 2
+#define TEST_PATTERN_DIAGONAL 3
+#define TEST_PATTERN_CLASSIC 4
+#define TEST_PATTERN_MARCHING_1S 5
+#define TEST_PATTERN_MONOCHROME_HORIZONTAL_BARS 6
+#define TEST_PATTERN_MONOCHROME_VERTICAL_BARS 7
+#define TEST_PATTERN_VERTICAL_COLOR_BARS 8
+
+#define TEST_PATTERN_CONTROL_POS 3
+#define ENABLE_TEST_PATTERN_MASK (1<<0)
+
+#endif /* TRDB_D5M_REGS_H */